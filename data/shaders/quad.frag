@@ -1,7 +1,7 @@
 #version 460
 
 layout(location=0) in vec2 f_uv;
-layout(binding=0,rgba8) uniform readonly image2D text;
+layout(binding=0,rgba32f) uniform readonly image2D text;
 
 layout(location=0) out vec4 outColor;
 
@@ -20,10 +20,25 @@ vec3 degamma(vec3 c)
 }
 
 
+//The trace runs at its own render scale, filter it to the window by hand since storage images cant be sampled
+vec4 loadBilinear(vec2 uv, ivec2 textureSz){
+	vec2 pos= uv*vec2(textureSz)-0.5;
+	ivec2 base= ivec2(floor(pos));
+	vec2 f= fract(pos);
+	ivec2 maxPos= textureSz-1;
+
+	vec4 c00= imageLoad(text,clamp(base,ivec2(0),maxPos));
+	vec4 c10= imageLoad(text,clamp(base+ivec2(1,0),ivec2(0),maxPos));
+	vec4 c01= imageLoad(text,clamp(base+ivec2(0,1),ivec2(0),maxPos));
+	vec4 c11= imageLoad(text,clamp(base+ivec2(1,1),ivec2(0),maxPos));
+	return mix(mix(c00,c10,f.x),mix(c01,c11,f.x),f.y);
+}
+
+
 void main(){
-	vec2 imgSize= imageSize(text);
+	ivec2 imgSize= imageSize(text);
 
-	vec4 color = imageLoad(text,toTexturePos(f_uv,imgSize));
+	vec4 color = loadBilinear(f_uv,imgSize);
 	//color.rgb= degamma(color.rgb);
 	//color.rgb=gamma(color.rgb);
 	outColor= normalize(vec4(color.rgb,1));
@@ -1,16 +1,37 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location=0) in vec3 fragColor;
 layout(location=1) in vec3 fragPosWorld;
 layout(location=2) in vec3 fragNormalWorld;
+layout(location=3) in vec2 fragUv;
 
 layout(location=0) out vec4 outColor;
 
 layout(push_constant) uniform Push{
 	mat4 modelMatrix;
-	mat4 normalMatrix;
+	mat4 normalMatrix; // Last column holds the bindless material buffer and material index buffer ids
 }push;
 
+// Tightly packed like NarwhalModel::MaterialObj, 80 bytes
+struct Material{
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	float transmittance[3];
+	float emission[3];
+	float shininess;
+	float ior;
+	float dissolve;
+	int illum;
+	int textureID;
+};
+
+// Bindless table, every buffer shares binding 0 so both views alias it
+layout(set=1,binding=0) readonly buffer Materials{ Material materials[]; } materialBuffers[];
+layout(set=1,binding=0) readonly buffer MaterialIndices{ int materialIndices[]; } materialIndexBuffers[];
+layout(set=1,binding=1) uniform sampler2D textures[];
+
 layout(constant_id=0) const int NUM_POINT_LIGHTS = 10;
 
 struct PointLight{
@@ -29,8 +50,24 @@ layout(set=0,binding=0) uniform GlobalUbo{
 
 
 
+vec3 getAlbedo(){
+	uint materialBuffer= floatBitsToUint(push.normalMatrix[3].x);
+	uint materialIndexBuffer= floatBitsToUint(push.normalMatrix[3].y);
+	if(materialBuffer==0xFFFFFFFFu || materialIndexBuffer==0xFFFFFFFFu) return fragColor;
+
+	// One material index per triangle
+	int materialIndex= materialIndexBuffers[nonuniformEXT(materialIndexBuffer)].materialIndices[gl_PrimitiveID];
+	Material material= materialBuffers[nonuniformEXT(materialBuffer)].materials[materialIndex];
+	vec3 albedo= vec3(material.diffuse[0],material.diffuse[1],material.diffuse[2]);
+	if(material.textureID>=0){
+		albedo*= texture(textures[nonuniformEXT(material.textureID)],fragUv).rgb;
+	}
+	return albedo;
+}
+
 void main(){
 	
+	vec3 albedo= getAlbedo();
 	vec3 diffuseLight= ubo.ambientLightColor.xyz* ubo.ambientLightColor.w;
 	vec3 specularLight= vec3(0.0);
 	vec3 surfaceNormal= normalize(fragNormalWorld);
@@ -64,5 +101,5 @@ void main(){
 	} 
 
 	//float lightIntensity= AMBIENT+ max(dot(normalWorldSpace,ubo.directionToLight),0);
-	outColor= vec4(diffuseLight*fragColor+specularLight*fragColor,1.0);
+	outColor= vec4(diffuseLight*albedo+specularLight*albedo,1.0);
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ layout(location=3) in vec2 uv;
 layout(location=0) out vec3 fragColor;
 layout(location=1) out vec3 fragPosWorld;
 layout(location=2) out vec3 fragNormalWorld;
+layout(location=3) out vec2 fragUv;
 
 layout(constant_id=0) const int NUM_POINT_LIGHTS = 10;
 
@@ -43,6 +44,7 @@ void main()
 	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
 	fragPosWorld= positionWorld.xyz;
 	fragColor= color;
+	fragUv= uv;
 	
 
 
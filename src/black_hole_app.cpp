@@ -7,11 +7,15 @@
 #include "narwhal_model.hpp"
 #include "narwhal_image.hpp"
 #include "narwhal_cameraV2.hpp"
+#include "narwhal_readback.hpp"
 
 #include "systems/narwhal_imgui.hpp"
 #include "systems/black_hole_compute_system.hpp"
 #include "systems/quad_render_system.hpp"
 #include "systems/black_hole_init_system.hpp"
+#include "systems/black_hole_tile_scheduler.hpp"
+#include "systems/black_hole_present_system.hpp"
+#include "systems/black_hole_async_compute.hpp"
 
 
 
@@ -23,6 +27,8 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
 //std
 #include <stdexcept>
@@ -31,9 +37,20 @@
 #include <chrono>
 #include <string>
 #include <functional>
+#include <vector>
+#include <ctime>
+#include <cstdio>
 
 
 #define MAX_DT 1.f //TODO: Change and tune
+#define CONVERGENCE_FRAMES 30 // Frames without a single finished pixel before the trace counts as converged
+#define MIN_RENDER_SCALE .25f
+#define MAX_RENDER_SCALE 2.f
+#define AUTO_SCALE_DEADBAND .1f // Relative scale change below which auto scaling doesnt bother reallocating
+#define IDLE_WAIT_TIMEOUT .5 // seconds, idle loop still wakes up this often to run readbacks
+#define IDLE_REDRAW_FRAMES 3 // Frames drawn after input while idle, imgui needs a couple to settle hovers
+#define TRACE_BYTES_PER_PIXEL 84 // Color, position, direction, present and display are rgba32f, complete is r32ui
+#define MEMORY_BUDGET_HEADROOM .9 // Part of the heap budget the trace is allowed to grow into
 
 
 namespace narwhal {
@@ -45,25 +62,28 @@ namespace narwhal {
 		glm::vec2 uv;
 	};
 
-	BlackHoleApp::BlackHoleApp() {
-		const int POOL_SETS_COUNT = 15;
-		globalPool = NarwhalDescriptorPool::Builder(narwhalDevice)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT*2)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT*8)
-			//.addPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT*2)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT*2)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.setMaxSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT * POOL_SETS_COUNT)
-			.build();
+	// Display image texels are RGBA32F, clamp them down to 8 bits and save next to the executable
+	static void saveScreenshot(const void* data, uint32_t width, uint32_t height)
+	{
+		const float* texels = static_cast<const float*>(data);
+		std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+		for (size_t i = 0; i < pixels.size(); i++) {
+			pixels[i] = static_cast<unsigned char>(glm::clamp(texels[i], 0.f, 1.f) * 255.f + .5f);
+		}
 
-		//Load Fence
-		VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-		vkCreateFence(narwhalDevice.device(), &fenceInfo, nullptr, &fence);
+		std::string fileName = "screenshot_" + std::to_string(std::time(nullptr)) + ".png";
+		if (stbi_write_png(fileName.c_str(), width, height, 4, pixels.data(), width * 4) == 0) {
+			std::cout << "Failed to write " << fileName << std::endl;
+			return;
+		}
+		std::cout << "Saved " << fileName << std::endl;
+	}
+
+	BlackHoleApp::BlackHoleApp() {
 	}
 
 
 	BlackHoleApp::~BlackHoleApp() {
-		vkDestroyFence(narwhalDevice.device(), fence, nullptr);
 	}
 
 
@@ -79,24 +99,34 @@ namespace narwhal {
 			narwhalRenderer.getImageCount() };
 
 		
-		VkExtent2D swapChainExtent = narwhalWindow.getExtent();
+		// The trace runs at its own resolution, the quad filters it to the window
+		VkExtent2D swapChainExtent = getTraceExtent(narwhalWindow.getExtent());
 
 		// Make Buffers
-		std::vector<std::unique_ptr<NarwhalBuffer>> parameterBuffers(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
-		std::vector<std::unique_ptr<NarwhalBuffer>> uboBuffers(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
-		std::unique_ptr<NarwhalBuffer> completedPixelBuffer=std::make_unique<NarwhalBuffer>(narwhalDevice,sizeof(int),1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		completedPixelBuffer->map();
-		int zero= 0;
-		completedPixelBuffer.get()->writeToBuffer(&zero, sizeof(int));
-		// Make Storage Images
-		NarwhalStorageImage storageColorImage(narwhalDevice, swapChainExtent.width, swapChainExtent.height);
-		NarwhalStorageImage storagePositionImage(narwhalDevice, swapChainExtent.width, swapChainExtent.height);
-		NarwhalStorageImage storageDirectionImage(narwhalDevice, swapChainExtent.width, swapChainExtent.height);
-		NarwhalStorageImage storageCompleteImage(narwhalDevice, swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R8_UINT);
-
-		//Make init data
-		std::unique_ptr<NarwhalBuffer> frameInitBuffer= std::make_unique<NarwhalBuffer>(narwhalDevice,sizeof(InitParameters), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		frameInitBuffer->map();
+		// One copy of the rarely changing parameters per batch slot, the per batch values go in as push constants
+		VkDeviceSize uniformAlignment = narwhalDevice.getLimits().minUniformBufferOffsetAlignment;
+		NarwhalBuffer parameterBuffer{ narwhalDevice, sizeof(BlackHoleParameters), NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformAlignment, NarwhalMemoryCategory::Uniforms };
+		NarwhalBuffer initParameterBuffer{ narwhalDevice, sizeof(InitParameters), NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformAlignment, NarwhalMemoryCategory::Uniforms };
+		parameterBuffer.map();
+		initParameterBuffer.map();
+		// Hash of what each slot's copy of the parameters holds, 0 forces the first write
+		std::vector<size_t> slotParameterHashes(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+		// Counters and screenshots come back through here a frame or two late instead of stalling
+		NarwhalReadback readback{ narwhalDevice };
+		BlackHoleTileScheduler tileScheduler(narwhalDevice, readback, swapChainExtent);
+		// Every load time upload goes through one batch, a single submit instead of one per image and face
+		NarwhalUploadBatch uploadBatch{ narwhalDevice };
+
+		// Make Storage Images, all but the display image start out on the compute queue that traces into them
+		NarwhalStorageImage storageColorImage(narwhalDevice, NarwhalQueueType::Compute, swapChainExtent.width, swapChainExtent.height);
+		NarwhalStorageImage storagePositionImage(narwhalDevice, NarwhalQueueType::Compute, swapChainExtent.width, swapChainExtent.height);
+		NarwhalStorageImage storageDirectionImage(narwhalDevice, NarwhalQueueType::Compute, swapChainExtent.width, swapChainExtent.height);
+		// 32 bit so the update shaders can claim a finished pixel with an image atomic
+		NarwhalStorageImage storageCompleteImage(narwhalDevice, NarwhalQueueType::Compute, swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R32_UINT);
+		NarwhalStorageImage storagePresentImage(narwhalDevice, NarwhalQueueType::Compute, swapChainExtent.width, swapChainExtent.height); // Resolved on the compute queue, the trace accumulates into storageColorImage
+		NarwhalStorageImage storageDisplayImage(narwhalDevice, uploadBatch, swapChainExtent.width, swapChainExtent.height); // Graphics queue copy of the present image, what the quad shows
 
 		//Make Cubemap Images
 		std::string rightPath = "data/textures/cubemap/right.png";
@@ -105,27 +135,18 @@ namespace narwhal {
 		std::string bottomPath = "data/textures/cubemap/bottom.png";
 		std::string frontPath = "data/textures/cubemap/front.png";
 		std::string backPath = "data/textures/cubemap/back.png";
-		NarwhalImage tempImage(narwhalDevice, "data/textures/blackbody.png");
-		NarwhalCubemap cubemapImage(narwhalDevice, 1024, 1024, rightPath, leftPath, topPath, bottomPath, frontPath, backPath);
+		NarwhalImage tempImage(narwhalDevice, uploadBatch, "data/textures/blackbody.png");
+		NarwhalCubemap cubemapImage(narwhalDevice, uploadBatch, 1024, 1024, rightPath, leftPath, topPath, bottomPath, frontPath, backPath);
+		uploadBatch.finish();
 		//Make other Images
 
-
-		for (int i = 0; i < NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
-
-			parameterBuffers[i] = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(BlackHoleComputeData),1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			uboBuffers[i] = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(GlobalUbo),1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			parameterBuffers[i]->map();
-			uboBuffers[i]->map();
-			
-		}
-
 		auto initSetLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Parameters
 			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Color Image
 			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Position Image
 			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Direction Image
 			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // isComplete Image
+			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Tile States
 			.build();
 		
 		auto computeSetLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
@@ -136,11 +157,20 @@ namespace narwhal {
 			.addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT) // Temp Image
 			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // isComplete Image
 			.addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT) // Background Cube map Image
-			.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Completed Pixel Buffer
+			.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Tile States
+			.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Tile List
 			.build();
 
 		
 
+		auto presentSetLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Accumulation Color Image
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // isComplete Image
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Present Image
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Position Image
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // Direction Image
+			.build();
+
 		auto renderSetLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
 			//.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS) // Global UBO
 			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // Color Image
@@ -151,65 +181,87 @@ namespace narwhal {
 		std::vector<VkDescriptorSet> computeDescriptorSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
 		std::vector<VkDescriptorSet> renderDescriptorSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
 		std::vector<VkDescriptorSet> initDescriptorSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
-		VkDescriptorSet initDescriptorSet;
+		std::vector<VkDescriptorSet> presentDescriptorSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
 
-		{
-			auto initBufferInfo= frameInitBuffer->descriptorInfo();
+		// The sets only point at the trace images and tile buffers, so they're written once here and again after a
+		// resize replaced those. Nothing gets written per frame, each slot has its own parameter copy
+		auto writeBatchSets = [&](int i) {
+			auto initBufferInfo = initParameterBuffer.descriptorInfoForIndex(i);
+			auto paramBufferInfo = parameterBuffer.descriptorInfoForIndex(i);
 			auto colorImageInfo = storageColorImage.getDescriptorImageInfo();
 			auto positionImageInfo = storagePositionImage.getDescriptorImageInfo();
 			auto directionImageInfo = storageDirectionImage.getDescriptorImageInfo();
 			auto completeImageInfo = storageCompleteImage.getDescriptorImageInfo();
+			auto presentImageInfo = storagePresentImage.getDescriptorImageInfo();
+			auto backgroundCubeMapInfo = cubemapImage.getDescriptorImageInfo();
+			auto tempImageInfo = tempImage.getDescriptorImageInfo();
+			auto tileStateBufferInfo = tileScheduler.getTileStateBufferInfo();
+			auto tileListBufferInfo = tileScheduler.getTileListBufferInfo(i);
 
-			NarwhalDescriptorWriter(*initSetLayout, *globalPool)
+			NarwhalDescriptorWriter(*initSetLayout, globalDescriptorAllocator)
 				.writeBuffer(0, &initBufferInfo)
 				.writeImage(1, &colorImageInfo)
 				.writeImage(2, &positionImageInfo)
 				.writeImage(3, &directionImageInfo)
 				.writeImage(4, &completeImageInfo)
-				.build(initDescriptorSet);
-		}
+				.writeBuffer(5, &tileStateBufferInfo)
+				.overwrite(initDescriptorSets[i]);
 
-		for (int i = 0; i < computeDescriptorSets.size(); i++) {
-			auto paramBufferInfo = parameterBuffers[i]->descriptorInfo();
-			auto colorImageInfo = storageColorImage.getDescriptorImageInfo();
-			auto positionImageInfo = storagePositionImage.getDescriptorImageInfo();
-			auto directionImageInfo = storageDirectionImage.getDescriptorImageInfo();
-			auto backgroundCubeMapInfo = cubemapImage.getDescriptorImageInfo();
-			auto completeImageInfo = storageCompleteImage.getDescriptorImageInfo();
-			auto tempImageInfo = tempImage.getDescriptorImageInfo();
-			auto completedPixelBufferInfo = completedPixelBuffer->descriptorInfo();
-
-
-			NarwhalDescriptorWriter(*computeSetLayout, *globalPool)
+			NarwhalDescriptorWriter(*computeSetLayout, globalDescriptorAllocator)
 				.writeBuffer(0, &paramBufferInfo)
 				.writeImage(1, &colorImageInfo)
 				.writeImage(2, &positionImageInfo)
 				.writeImage(3, &directionImageInfo)
 				.writeImage(4, &tempImageInfo)
-				.writeImage(5,&completeImageInfo)
+				.writeImage(5, &completeImageInfo)
 				.writeImage(6, &backgroundCubeMapInfo)
-				.writeBuffer(7, &completedPixelBufferInfo)
-				.build(computeDescriptorSets[i]);
-		}
-
-		for (int i = 0;  i < renderDescriptorSets.size();i++){
-			auto uboBufferInfo = uboBuffers[i]->descriptorInfo();
-			auto colorImageInfo = storageColorImage.getDescriptorImageInfo();
+				.writeBuffer(7, &tileStateBufferInfo)
+				.writeBuffer(8, &tileListBufferInfo)
+				.overwrite(computeDescriptorSets[i]);
 
-			NarwhalDescriptorWriter(*renderSetLayout, *globalPool)
-				//.writeBuffer(0, &uboBufferInfo)
+			NarwhalDescriptorWriter(*presentSetLayout, globalDescriptorAllocator)
 				.writeImage(0, &colorImageInfo)
-				.build(renderDescriptorSets[i]);		
+				.writeImage(1, &completeImageInfo)
+				.writeImage(2, &presentImageInfo)
+				.writeImage(3, &positionImageInfo)
+				.writeImage(4, &directionImageInfo)
+				.overwrite(presentDescriptorSets[i]);
 		};
 
-		
+		auto writeRenderSet = [&](int i) {
+			auto displayImageInfo = storageDisplayImage.getDescriptorImageInfo();
+			NarwhalDescriptorWriter(*renderSetLayout, globalDescriptorAllocator)
+				.writeImage(0, &displayImageInfo)
+				.overwrite(renderDescriptorSets[i]);
+		};
 
+		// One set per batch and frame slot so a resize can rewrite a slot while the other one is still on the gpu
+		for (int i = 0; i < NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+			if (!globalDescriptorAllocator.allocate(initSetLayout->getDescriptorSetLayout(), initDescriptorSets[i]) ||
+				!globalDescriptorAllocator.allocate(computeSetLayout->getDescriptorSetLayout(), computeDescriptorSets[i]) ||
+				!globalDescriptorAllocator.allocate(presentSetLayout->getDescriptorSetLayout(), presentDescriptorSets[i]) ||
+				!globalDescriptorAllocator.allocate(renderSetLayout->getDescriptorSetLayout(), renderDescriptorSets[i])) {
+				throw std::runtime_error("failed to allocate descriptor set!");
+			}
+			writeBatchSets(i);
+			writeRenderSet(i);
+		}
 
+		// Bumped on resize, a slot catches up the next time it comes around and its old work is done
+		uint32_t traceGeneration = 0;
+		std::vector<uint32_t> batchSetGenerations(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+		std::vector<uint32_t> renderSetGenerations(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
 
 		//Load Systems
-		BlackHoleComputeSystem blackHoleComputeSystem{ narwhalDevice, narwhalRenderer.getSwapChainRenderPass(), computeSetLayout->getDescriptorSetLayout()};
+		// The systems queue their pipelines on the compiler threads and only wait when they first record, so these all build in parallel
+		BlackHoleComputeSystem blackHoleComputeSystem{ narwhalDevice, computeSetLayout->getDescriptorSetLayout(), computeData.params.blackHoleType};
 		QuadRenderSystem quadRenderSystem{ narwhalDevice, narwhalRenderer.getSwapChainRenderPass(), renderSetLayout->getDescriptorSetLayout()};
-		BlackHoleInitSystem blackHoleInitSystem{ narwhalDevice, narwhalRenderer.getSwapChainRenderPass(), initSetLayout->getDescriptorSetLayout()};
+		BlackHoleInitSystem blackHoleInitSystem{ narwhalDevice, initSetLayout->getDescriptorSetLayout()};
+		BlackHolePresentSystem blackHolePresentSystem{ narwhalDevice, presentSetLayout->getDescriptorSetLayout()};
+		BlackHoleAsyncCompute asyncCompute{ narwhalDevice, storagePresentImage, storageDisplayImage };
+		// The textures were uploaded on the graphics queue, the trace images and tile states were made on the compute queue
+		asyncCompute.adoptImage(tempImage.getImage(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		asyncCompute.adoptImage(cubemapImage.getImage(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		//Load Camera (TODO: REMOVE)
 		NarwhalCamera camera{};
@@ -221,7 +273,7 @@ namespace narwhal {
 		camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
 		//Load Camera V2
-		VkExtent2D newSize = narwhalWindow.getExtent();
+		VkExtent2D newSize = swapChainExtent;
 		const glm::vec3 cameraPos = glm::vec3(-4,1,0);
 		const glm::vec3 cameraTarget = glm::vec3(0,0,0);
 		NarwhalCameraV2 cameraV2;
@@ -233,54 +285,148 @@ namespace narwhal {
 		cameraV2.enable();
 		auto startTime = std::chrono::high_resolution_clock::now();
 		auto currentTime = startTime;
-		VkExtent2D oldSize = narwhalWindow.getExtent();
+		auto lastBatchTime = startTime;
+		VkExtent2D oldSize = swapChainExtent;
+		auto traceStartTime = startTime;
 
 
 
 		bool shouldInitFrame = true;
+		bool shouldSwapPresent = false;
+		bool hasSwappedPresent = false; // Until the first swap the present image shows the best-so-far trace
 		int framesSincePercentageCheck = 0;
+		int framesWithoutProgress = 0;
+		float lastCompletedFraction = 0.f;
+		int lastRenderTextureIndex = renderTextureIndex;
+		bool traceFinished = false; // Converged and kept on screen, nothing gets traced until something changes
+		int redrawFrames = 0;
+
+		// Finished trace already in the display image and nothing asking for more, the gpu can go idle
+		auto isTraceIdle = [&]() {
+			return traceFinished && idleWhenConverged && !orbitCamera && !shouldInitFrame && !shouldSwapPresent
+				&& renderTextureIndex == lastRenderTextureIndex && asyncCompute.ownsPresentImage() && !blackHoleComputeSystem.isUsingFallback()
+				&& !blackHoleComputeSystem.getWorkgroupTuner().isTuning()
+				&& glfwGetKey(narwhalWindow.getGLFWwindow(), GLFW_KEY_SPACE) != GLFW_PRESS;
+		};
 
 		// Main Loop
 		while (!narwhalWindow.shouldClose()) {
-			glfwPollEvents(); 
+			if (isTraceIdle() && redrawFrames == 0) {
+				narwhalWindow.waitEvents(IDLE_WAIT_TIMEOUT);
+			}
+			else {
+				glfwPollEvents();
+			}
+			if (narwhalWindow.consumeActivity()) redrawFrames = IDLE_REDRAW_FRAMES;
+			readback.update();
 			//Update
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
 			deltaTime = glm::min(deltaTime, MAX_DT);
 			
-			//Update size (TODO)
-			newSize = narwhalWindow.getExtent();
+			//Update size, follows both the window and the render scale. A minimized window keeps the last trace size
+			VkExtent2D windowSize = narwhalWindow.getExtent();
+			if (windowSize.width > 0 && windowSize.height > 0) {
+				fitRenderScaleToBudget(windowSize, oldSize);
+				newSize = getTraceExtent(windowSize);
+			}
 			if (newSize.width != oldSize.width || newSize.height != oldSize.height) {
 				oldSize = newSize;
-				//TODO: Change size of images
+				// Nothing waits on the device, the old images and buffers are retired until the batches and frames using them finished
+				storageColorImage.resize(newSize.width, newSize.height);
+				storagePositionImage.resize(newSize.width, newSize.height);
+				storageDirectionImage.resize(newSize.width, newSize.height);
+				storageCompleteImage.resize(newSize.width, newSize.height);
+				storagePresentImage.resize(newSize.width, newSize.height);
+				storageDisplayImage.resize(newSize.width, newSize.height);
+				tileScheduler.resize(newSize);
+				asyncCompute.resetPresentImage();
+				traceGeneration++;
+
+				cameraV2.setPerspective(90, newSize.width / (float)newSize.height, 0.3f, 1000.0f);
+				orbitCam.setPerspective(90, newSize.width / (float)newSize.height, 0.3f, 1000.0f);
+				shouldInitFrame = true;
+				shouldSwapPresent = false;
+				hasSwappedPresent = false;
 			}
-			framesSincePercentageCheck += 1;
-			// Check if number of completed pixels is over threshold
-			if (framesSincePercentageCheck>=percentageCheckInterval){
-				if (!shouldInitFrame) {
-					framesSincePercentageCheck = 0;
-					int completedPixels = 0;
-					int maxPixels = newSize.width * newSize.height; //TODO: Fit actual image size
-					memcpy(&completedPixels, completedPixelBuffer->getMappedMemory(), sizeof(int));
-					float percent = (float)completedPixels / (float)maxPixels;
-					float threshold= computeData.params.blackHoleType== BlackHoleType::Schwarzchild ? schwarzchildFrameThreshold : kerrFrameThreshold;
-					if (percent > threshold) {
-						shouldInitFrame = true;
-					}
+
+			bool traceIdle = isTraceIdle();
+
+			// Trace on the compute queue, a batch slot only frees up once its previous submit finished so a long
+			// kerr integration just skips batches instead of stalling the ui
+			VkCommandBuffer computeCommandBuffer = traceIdle ? nullptr : asyncCompute.beginBatch();
+			if (computeCommandBuffer) {
+				int batchIndex = asyncCompute.getBatchIndex();
+				// beginBatch waited for this slot's previous submit, its parameters and sets are free again
+				size_t parameterHash = std::hash<BlackHoleParameters>{}(computeData.params);
+				if (slotParameterHashes[batchIndex] != parameterHash) {
+					parameterBuffer.writeToIndex(&computeData.params, batchIndex);
+					slotParameterHashes[batchIndex] = parameterHash;
+				}
+				if (batchSetGenerations[batchIndex] != traceGeneration) {
+					writeBatchSets(batchIndex);
+					batchSetGenerations[batchIndex] = traceGeneration;
 				}
+				float batchTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - lastBatchTime).count();
+				lastBatchTime = newTime;
+				framesSincePercentageCheck += 1;
+				// Counted in batches, the tile stats only move when one runs
+				// Track when the trace stops making progress, kerr rays that never escape keep it from ever reaching 100%
+				float completedFraction = tileScheduler.getStats().completedFraction;
+				framesWithoutProgress = completedFraction > lastCompletedFraction ? 0 : framesWithoutProgress + 1;
+				lastCompletedFraction = completedFraction;
+				// Check if number of completed pixels is over threshold
+				if (framesSincePercentageCheck>=percentageCheckInterval){
+					if (!shouldInitFrame) {
+						framesSincePercentageCheck = 0;
+						float threshold= computeData.params.blackHoleType== BlackHoleType::Schwarzchild ? schwarzchildFrameThreshold : kerrFrameThreshold;
+						bool converged = tileScheduler.getStats().activeTiles == 0 || framesWithoutProgress >= CONVERGENCE_FRAMES;
+						bool traceDone = presentPolicy == PresentSwapPolicy::OnConvergence ? converged : completedFraction > threshold;
+						float traceTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - traceStartTime).count();
+						bool canIdle = idleWhenConverged && !orbitCamera;
+						if (traceFinished) {
+							// Idling got switched off or the orbit camera on, go back to retracing
+							if (!canIdle) shouldInitFrame = true;
+						}
+						else if (canIdle && converged) {
+							// Nothing to move on to, show the finished trace and stop tracing
+							traceFinished = true;
+							shouldSwapPresent = true;
+							if (autoRenderScale) updateAutoRenderScale(traceTime);
+						}
+						else if (traceDone && !canIdle) {
+							shouldInitFrame = true;
+							shouldSwapPresent = presentPolicy != PresentSwapPolicy::Blended;
+							if (autoRenderScale) updateAutoRenderScale(traceTime);
+						}
+						else if (autoRenderScale && traceTime > targetTraceTime * 2.f) {
+							// Way over target, dont wait for it to finish before scaling down
+							updateAutoRenderScale(traceTime);
+						}
+					}
 
-			}
-			
+				}
 
-			if (auto commandBuffer = narwhalRenderer.beginFrame()) { //Will return a null ptr if swap chain needs to be recreated
-				int frameIndex = narwhalRenderer.getFrameIndex();
-				
+				// The present image can be on the graphics queue, swap and init wait for it to come back
+				bool ownsPresent = asyncCompute.ownsPresentImage();
+				bool presentWritten = false;
+
+				PresentFrameInfo presentFrameInfo{ batchIndex,computeCommandBuffer,presentDescriptorSets[batchIndex] };
+				// Hand the finished trace to the present image before init wipes the accumulation image
+				if (shouldSwapPresent && ownsPresent) {
+					shouldSwapPresent = false;
+					hasSwappedPresent = true;
+					presentWritten = true;
+					blackHolePresentSystem.resolve(presentFrameInfo, PresentResolveMode::Copy, 1.f, newSize);
+				}
 
-				
-				
-				if (shouldInitFrame or glfwGetKey(narwhalWindow.getGLFWwindow(), GLFW_KEY_SPACE) == GLFW_PRESS) {
+				if ((shouldInitFrame && !shouldSwapPresent) or glfwGetKey(narwhalWindow.getGLFWwindow(), GLFW_KEY_SPACE) == GLFW_PRESS) {
 					shouldInitFrame = false;
+					lastCompletedFraction = 0.f;
+					framesWithoutProgress = 0;
+					traceStartTime = newTime;
+					traceFinished = false;
 					/*
 					glm::mat4 camToWorld = glm::mat4(0.06699, 0.25000, -0.96593, -4.00000, 0.25000, 0.93301, 0.25882, 1.00000, -0.96593, 0.25882, 0.00000, 0.00000, 0.00000, 0.00000, 0.00000, 1.00000);
 					glm::mat4 invProj = glm::mat4(2.12548, 0.00000, 0.00000, 0.00000,0.00000, 1.00000, 0.00000, 0.00000,0.00000, 0.00000, 0.00000, -1.00000,0.00000, 0.00000, -1.66617, 1.66717);
@@ -350,99 +496,86 @@ namespace narwhal {
 					
 					Matrix44 camToWorld = invView * invProj;
 
-					initParameters.windowSize= glm::ivec2(newSize.width, newSize.height);
-					initParameters.camToWorld = cam.view_matrix;
+					InitPush initPush{};
+					initPush.windowSize= glm::ivec2(newSize.width, newSize.height);
+					initPush.tileCount = tileScheduler.getTileCount();
+					initPush.camToWorld = cam.view_matrix;
+					initPush.camPosCartesian = cam.eye;
+					initPush.camPosSpherical = glm::vec3(r,theta,phi);
+
 					initParameters.camInverseProj = invProj;
-					initParameters.camPosCartesian = cam.eye;
-					initParameters.camPosSpherical = glm::vec3(r,theta,phi);
 					initParameters.horizonRadius = computeData.params.horizonRadius;
-					
-					completedPixelBuffer.get()->writeToBuffer(&zero, sizeof(int)); // Reset completed pixel count to zero
-					
+					initParameterBuffer.writeToIndex(&initParameters, batchIndex);
 
+					InitFrameInfo initFrameInfo{batchIndex,computeCommandBuffer,initDescriptorSets[batchIndex],initPush};
+					blackHoleInitSystem.initFrame(initFrameInfo, newSize, tileScheduler);
+				}
 
-					frameInitBuffer->writeToBuffer(&initParameters, sizeof(initParameters));
-
-					auto initBufferInfo = frameInitBuffer->descriptorInfo();
-					auto colorImageInfo = storageColorImage.getDescriptorImageInfo();
-					auto positionImageInfo = storagePositionImage.getDescriptorImageInfo();
-					auto directionImageInfo = storageDirectionImage.getDescriptorImageInfo();
-					auto completeImageInfo = storageCompleteImage.getDescriptorImageInfo();
+				computeData.push.windowSize = glm::ivec2(newSize.width, newSize.height);
+				computeData.push.tileCount = tileScheduler.getTileCount();
+				computeData.push.time = std::chrono::duration<float, std::chrono::seconds::period>(newTime - startTime).count();
 
-					NarwhalDescriptorWriter(*initSetLayout, *globalPool)
-						.writeBuffer(0, &initBufferInfo)
-						.writeImage(1, &colorImageInfo)
-						.writeImage(2, &positionImageInfo)
-						.writeImage(3, &directionImageInfo)
-						.writeImage(4, &completeImageInfo)
-						.overwrite(initDescriptorSet);
+				// The frame budget applies to the batch cadence, that's how often finished pixels can reach the screen
+				BlackHoleFrameInfo frameInfo{batchIndex,batchTime,computeCommandBuffer,computeDescriptorSets[batchIndex],computeData.push };
 
+				blackHoleComputeSystem.render(frameInfo, computeData.params, tileScheduler);
+				// What got traced so far used the fallback metric
+				if (blackHoleComputeSystem.consumePipelineSwap()) shouldInitFrame = true;
 
-					InitFrameInfo initFrameInfo{frameIndex,commandBuffer,initDescriptorSet,fence};
-					blackHoleInitSystem.initFrame(initFrameInfo, newSize);
+				if (ownsPresent) {
+					if (renderTextureIndex != 0) {
+						// Debug views overwrite the present image with the raw trace state
+						PresentResolveMode debugModes[] = { PresentResolveMode::Position, PresentResolveMode::Direction, PresentResolveMode::IsComplete };
+						blackHolePresentSystem.resolve(presentFrameInfo, debugModes[renderTextureIndex - 1], 1.f, newSize);
+						presentWritten = true;
+					}
+					else if (lastRenderTextureIndex != 0) {
+						// Back from a debug view, there's no trace left in the present image to blend over
+						blackHolePresentSystem.resolve(presentFrameInfo, PresentResolveMode::Copy, 1.f, newSize);
+						presentWritten = true;
+					}
+					else if ((presentPolicy == PresentSwapPolicy::Blended || !hasSwappedPresent) && !traceFinished) {
+						float blendFactor = presentPolicy == PresentSwapPolicy::Blended ? presentBlendFactor : 1.f;
+						blackHolePresentSystem.resolve(presentFrameInfo, PresentResolveMode::Blend, blendFactor, newSize);
+						presentWritten = true;
+					}
+					lastRenderTextureIndex = renderTextureIndex;
 				}
-				
-				computeData.windowSize = glm::ivec2(newSize.width, newSize.height);
-				computeData.time = std::chrono::duration<float, std::chrono::seconds::period>(newTime - startTime).count();
-				//Update compute descriptor sets
-				
-				//Update computeDescriptorSets 0 with blackHoleParameters
-				parameterBuffers[frameIndex]->writeToBuffer(&computeData, sizeof(BlackHoleComputeData));
-				
-				auto paramBufferInfo = parameterBuffers[frameIndex]->descriptorInfo();
-				auto colorImageInfo = storageColorImage.getDescriptorImageInfo();
-				auto positionImageInfo = storagePositionImage.getDescriptorImageInfo();
-				auto directionImageInfo = storageDirectionImage.getDescriptorImageInfo();
-				auto backgroundCubeMapInfo = cubemapImage.getDescriptorImageInfo();
-				auto completeImageInfo = storageCompleteImage.getDescriptorImageInfo();
-				auto tempImageInfo = tempImage.getDescriptorImageInfo();
-				auto completedPixelBufferInfo = completedPixelBuffer->descriptorInfo();
-
-
-				NarwhalDescriptorWriter(*computeSetLayout, *globalPool)
-					.writeBuffer(0, &paramBufferInfo)
-					.writeImage(1, &colorImageInfo)
-					.writeImage(2, &positionImageInfo)
-					.writeImage(3, &directionImageInfo)
-					.writeImage(4, &tempImageInfo)
-					.writeImage(5, &completeImageInfo)
-					.writeImage(6, &backgroundCubeMapInfo)
-					.writeBuffer(7, &completedPixelBufferInfo)
-					.overwrite(computeDescriptorSets[frameIndex]);
-
-
-				BlackHoleFrameInfo frameInfo{frameIndex,deltaTime,commandBuffer,computeDescriptorSets[frameIndex],fence };
-
-				blackHoleComputeSystem.render(frameInfo, computeData.params, newSize);
-		
 
 				//std::cout << "Completed Pixels: " << computeData.completedPixels << std::endl;
 
-				//Update Render Descriptor Sets
-				VkDescriptorImageInfo& renderInfo= colorImageInfo;
-				if (renderTextureIndex == 1) {//Position
-					renderInfo = positionImageInfo;
+				if (presentWritten) {
+					asyncCompute.releasePresentImage(computeCommandBuffer);
 				}
-				else if (renderTextureIndex==2) //Direction
-				{
-					renderInfo = directionImageInfo;
+				readback.submitted(NarwhalQueueType::Compute, asyncCompute.endBatch());
+			}
 
+			// While idle only input gets a frame drawn, nothing on screen changes otherwise
+			VkCommandBuffer commandBuffer = traceIdle && redrawFrames == 0 ? nullptr : narwhalRenderer.beginFrame();
+			if (commandBuffer) { //Will return a null ptr if swap chain needs to be recreated
+				int frameIndex = narwhalRenderer.getFrameIndex();
+
+				// Copies out the present image if the compute queue released a new one
+				asyncCompute.recordDisplayCopy(commandBuffer, narwhalRenderer);
+
+				if (screenshotRequested) {
+					uint32_t width = storageDisplayImage.getWidth();
+					uint32_t height = storageDisplayImage.getHeight();
+					// Stays requested if every readback slot is busy, it'll go out next frame
+					screenshotRequested = !readback.readImage(commandBuffer, NarwhalQueueType::Graphics, storageDisplayImage.getImage(), VK_IMAGE_LAYOUT_GENERAL, width, height, 4 * sizeof(float),
+						[width, height](const void* data, VkDeviceSize size) { saveScreenshot(data, width, height); },
+						VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
 				}
-				else if (renderTextureIndex == 3) { // IsComplete
-					renderInfo = completeImageInfo;
+
+				// beginFrame waited on this frame slot, its set is free to point at the resized display image
+				if (renderSetGenerations[frameIndex] != traceGeneration) {
+					writeRenderSet(frameIndex);
+					renderSetGenerations[frameIndex] = traceGeneration;
 				}
-					
 
-				
+				QuadFrameInfo quadFrameInfo{ frameIndex,commandBuffer,renderDescriptorSets[frameIndex] };
 
-				NarwhalDescriptorWriter(*renderSetLayout, *globalPool)
-					.writeImage(0, &renderInfo)
-					//.writeImage(0, &positionImageInfo)
-					.overwrite(renderDescriptorSets[frameIndex]);
 
-				QuadFrameInfo quadFrameInfo{ frameIndex,commandBuffer,renderDescriptorSets[frameIndex] };
-				
-				
 				std::hash<BlackHoleParameters> computeDataHasher;
 				std::hash<NarwhalCameraV2> cameraHasher;
 				auto prevComputeDataHash = computeDataHasher(computeData.params);
@@ -453,10 +586,12 @@ namespace narwhal {
 
 
 				narwhalRenderer.beginSwapChainRenderPass(commandBuffer);
-				quadRenderSystem.render(quadFrameInfo);	
-				renderImgui(narwhalImgui, commandBuffer);
+				quadRenderSystem.render(quadFrameInfo);
+				renderImgui(narwhalImgui, commandBuffer, blackHoleComputeSystem, tileScheduler);
 				narwhalRenderer.endSwapChainRenderPass(commandBuffer);
 				narwhalRenderer.endFrame();
+				readback.submitted(NarwhalQueueType::Graphics, narwhalRenderer.getLastSubmission());
+				if (redrawFrames > 0) redrawFrames--;
 
 				//std::cout<< "Camera Hash: " << cameraHasher(cameraV2) << std::endl;
 				//std::cout << "Compute Data Hash: " << computeDataHasher(computeData.params) << std::endl;
@@ -465,7 +600,7 @@ namespace narwhal {
 					shouldInitFrame = true;
 				}
 			}
-			
+
 
 
 		}
@@ -473,7 +608,64 @@ namespace narwhal {
 
 	}
 
-	void BlackHoleApp::renderImgui(NarwhalImgui& narwhalImgui, VkCommandBuffer commandBuffer)
+	VkExtent2D BlackHoleApp::getTraceExtent(VkExtent2D windowExtent) const
+	{
+		uint32_t width = static_cast<uint32_t>(windowExtent.width * renderScale + .5f);
+		uint32_t height = static_cast<uint32_t>(windowExtent.height * renderScale + .5f);
+		return { glm::max(width, 1u), glm::max(height, 1u) };
+	}
+
+	void BlackHoleApp::updateAutoRenderScale(float traceTime)
+	{
+		// Pixel count goes with the square of the scale and the trace time roughly with the pixel count
+		float scale = renderScale * glm::sqrt(targetTraceTime / glm::max(traceTime, .001f));
+		scale = glm::clamp(scale, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+		if (glm::abs(scale - renderScale) < renderScale * AUTO_SCALE_DEADBAND) return;
+
+		renderScale = scale;
+		pendingRenderScale = scale;
+	}
+
+	// Device local memory of a trace, the images plus one TileState per started tile
+	static VkDeviceSize getTraceBytes(VkExtent2D extent)
+	{
+		VkDeviceSize tiles = static_cast<VkDeviceSize>((extent.width + TILE_SIZE - 1) / TILE_SIZE) * ((extent.height + TILE_SIZE - 1) / TILE_SIZE);
+		return static_cast<VkDeviceSize>(extent.width) * extent.height * TRACE_BYTES_PER_PIXEL + tiles * sizeof(TileState);
+	}
+
+	void BlackHoleApp::fitRenderScaleToBudget(VkExtent2D windowExtent, VkExtent2D traceExtent)
+	{
+		VkDeviceSize currentBytes = getTraceBytes(traceExtent);
+		VkExtent2D wantedExtent = getTraceExtent(windowExtent);
+		VkDeviceSize wantedBytes = getTraceBytes(wantedExtent);
+		if (wantedBytes <= currentBytes) {
+			if (wantedBytes < currentBytes) budgetLimited = false;
+			return;
+		}
+
+		// The old trace stays alive until the batches using it finished, so the new one has to fit next to it
+		NarwhalHeapBudget budget = narwhalDevice.getAllocator().getDeviceLocalBudget();
+		VkDeviceSize limit = static_cast<VkDeviceSize>(budget.budget * MEMORY_BUDGET_HEADROOM);
+		VkDeviceSize available = limit > budget.usage ? limit - budget.usage : 0;
+		if (wantedBytes <= available) {
+			budgetLimited = false;
+			return;
+		}
+
+		// Biggest trace that still fits, never smaller than the one already allocated since shrinking wouldnt free anything yet
+		VkDeviceSize fittingBytes = glm::max(available, currentBytes);
+		float scale = renderScale * glm::sqrt(static_cast<float>(fittingBytes) / static_cast<float>(wantedBytes));
+		renderScale = glm::max(scale, MIN_RENDER_SCALE);
+		pendingRenderScale = renderScale;
+		budgetLimited = true;
+	}
+
+	static float toMegabytes(VkDeviceSize bytes)
+	{
+		return bytes / (1024.f * 1024.f);
+	}
+
+	void BlackHoleApp::renderImgui(NarwhalImgui& narwhalImgui, VkCommandBuffer commandBuffer, BlackHoleComputeSystem& computeSystem, BlackHoleTileScheduler& tileScheduler)
 	{
 		if (!showImgui) return;
 
@@ -486,6 +678,7 @@ namespace narwhal {
 		ImGui::Begin("Black Hole Parameters");
 		ImGui::Text("FPS: %.1f", fps);
 		ImGui::Text("Average FPS: %.1f", ImGui::GetIO().Framerate);
+		if (ImGui::Button("Screenshot")) screenshotRequested = true;
 
 		
 		
@@ -495,6 +688,9 @@ namespace narwhal {
 		ImGui::RadioButton("Kerr", &blackHoleType, 1);
 		
 		computeData.params.blackHoleType = (BlackHoleType) blackHoleType;
+		if (computeSystem.isUsingFallback()) {
+			ImGui::TextDisabled("Compiling the %s pipeline, showing %s meanwhile", blackHoleType == 0 ? "Schwarzschild" : "Kerr", blackHoleType == 0 ? "Kerr" : "Schwarzschild");
+		}
 
 		if (NarwhalCameraV2::current) {
 			if (ImGui::CollapsingHeader("Camera")) {
@@ -570,6 +766,122 @@ namespace narwhal {
 		if (ImGui::CollapsingHeader("Render Parameters")) {
 	
 			ImGui::ListBox("Render Texture", &renderTextureIndex, renderTextures, 4, 4);
+
+			int swapPolicy = (int)presentPolicy;
+			ImGui::Text("Present Swap"); ImGui::SameLine();
+			ImGui::RadioButton("On Convergence", &swapPolicy, 0); ImGui::SameLine();
+			ImGui::RadioButton("On Threshold", &swapPolicy, 1); ImGui::SameLine();
+			ImGui::RadioButton("Blended", &swapPolicy, 2);
+			presentPolicy = (PresentSwapPolicy)swapPolicy;
+			if (presentPolicy == PresentSwapPolicy::Blended) {
+				ImGui::SliderFloat("Blend Factor", &presentBlendFactor, 0.01f, 1.f);
+			}
+
+			// Freezes the disk rotation on the last finished trace
+			ImGui::Checkbox("Idle When Converged", &idleWhenConverged);
+
+			ImGui::Separator();
+			ImGui::Checkbox("Auto Render Scale", &autoRenderScale);
+			if (autoRenderScale) {
+				ImGui::SliderFloat("Target Trace Time (s)", &targetTraceTime, .25f, 30.f, "%.2f");
+				ImGui::BeginDisabled();
+			}
+			// Only applied on release, every change reallocates the trace
+			ImGui::SliderFloat("Render Scale", &pendingRenderScale, MIN_RENDER_SCALE, MAX_RENDER_SCALE, "%.2fx");
+			if (ImGui::IsItemDeactivatedAfterEdit()) renderScale = pendingRenderScale;
+			if (autoRenderScale) ImGui::EndDisabled();
+			VkExtent2D traceExtent = getTraceExtent(narwhalWindow.getExtent());
+			ImGui::Text("Trace Resolution: %u x %u", traceExtent.width, traceExtent.height);
+			if (budgetLimited) {
+				ImGui::TextColored(ImVec4(1.f, .6f, .2f, 1.f), "Render scale limited by the memory budget");
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Memory")) {
+			NarwhalAllocator& allocator = narwhalDevice.getAllocator();
+			std::vector<NarwhalHeapBudget> budgets = allocator.getHeapBudgets();
+			ImGui::Text(narwhalDevice.hasMemoryBudget() ? "Budget from VK_EXT_memory_budget" : "Budget estimated, VK_EXT_memory_budget not supported");
+			for (size_t i = 0; i < budgets.size(); i++) {
+				const NarwhalHeapBudget& budget = budgets[i];
+				char overlay[64];
+				snprintf(overlay, sizeof(overlay), "%.0f / %.0f MB", toMegabytes(budget.usage), toMegabytes(budget.budget));
+				ImGui::Text("Heap %zu%s", i, (budget.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "");
+				ImGui::ProgressBar(budget.budget > 0 ? (float)budget.usage / (float)budget.budget : 0.f, ImVec2(-1.f, 0.f), overlay);
+			}
+
+			ImGui::Separator();
+			auto categoryStats = allocator.getCategoryStats();
+			for (size_t i = 0; i < categoryStats.size(); i++) {
+				ImGui::Text("%s: %.2f MB (%u)", getMemoryCategoryName((NarwhalMemoryCategory)i), toMegabytes(categoryStats[i].bytes), categoryStats[i].count);
+			}
+
+			ImGui::Separator();
+			std::vector<NarwhalHeapStats> heapStats = allocator.getHeapStats();
+			for (size_t i = 0; i < heapStats.size(); i++) {
+				const NarwhalHeapStats& stats = heapStats[i];
+				if (stats.blockCount == 0 && stats.dedicatedCount == 0) continue;
+				ImGui::Text("Heap %zu: %u blocks, %.1f / %.1f MB used, %u dedicated (%.1f MB)", i, stats.blockCount,
+					toMegabytes(stats.usedBytes), toMegabytes(stats.blockBytes), stats.dedicatedCount, toMegabytes(stats.dedicatedBytes));
+			}
+
+			NarwhalDescriptorAllocatorStats descriptorStats = globalDescriptorAllocator.getStats();
+			ImGui::Text("Descriptor Pools: %u, %u / %u sets", descriptorStats.poolCount, descriptorStats.setCount, descriptorStats.setCapacity);
+
+			NarwhalStagingPool& stagingPool = narwhalDevice.getStagingPool();
+			NarwhalStagingStats uploadStats = stagingPool.getStats(NarwhalStagingUsage::Upload);
+			NarwhalStagingStats readbackStats = stagingPool.getStats(NarwhalStagingUsage::Readback);
+			ImGui::Text("Upload Staging: %u chunks, %.1f / %.1f MB, peak %.1f MB", uploadStats.chunkCount,
+				toMegabytes(uploadStats.reserved), toMegabytes(uploadStats.capacity), toMegabytes(uploadStats.peak));
+			ImGui::Text("Readback Staging: %u chunks, %.1f / %.1f MB, peak %.1f MB", readbackStats.chunkCount,
+				toMegabytes(readbackStats.reserved), toMegabytes(readbackStats.capacity), toMegabytes(readbackStats.peak));
+		}
+
+		if (ImGui::CollapsingHeader("Performance")) {
+			ComputeScheduleSettings& schedule = computeSystem.getScheduleSettings();
+			const ComputeScheduleStats& stats = computeSystem.getScheduleStats();
+
+			int scheduleMode = (int)schedule.mode;
+			ImGui::Text("Schedule"); ImGui::SameLine();
+			ImGui::RadioButton("Fixed", &scheduleMode, 0); ImGui::SameLine();
+			ImGui::RadioButton("Frame Budget", &scheduleMode, 1); ImGui::SameLine();
+			ImGui::RadioButton("Max Throughput", &scheduleMode, 2);
+			schedule.mode = (ComputeScheduleMode)scheduleMode;
+
+			if (schedule.mode == ComputeScheduleMode::Fixed) {
+				ImGui::SliderInt("Steps Per Dispatch", &schedule.fixedStepsPerDispatch, 1, stats.maxStepsPerDispatch);
+			}
+			else if (schedule.mode == ComputeScheduleMode::FrameBudget) {
+				ImGui::SliderFloat("Target Frame Time (ms)", &schedule.targetFrameTime, 4.f, 100.f, "%.1f");
+			}
+
+			if (!stats.timestampsSupported) {
+				ImGui::Text("GPU timestamps not supported, using fixed steps per dispatch");
+			}
+			ImGui::Text("Compute Time: %.2f ms", stats.computeTime);
+			ImGui::Text("Steps Per Dispatch: %d / %d", stats.stepsPerDispatch, stats.maxStepsPerDispatch);
+
+			// Tunes the kernel of the metric on screen, the result is kept per device in workgroup_sizes.txt
+			const NarwhalWorkgroupTuner& tuner = computeSystem.getWorkgroupTuner();
+			NarwhalWorkgroupShape shape = computeSystem.getWorkgroupShape(computeData.params.blackHoleType);
+			ImGui::Text("Work Group: %ux%u%s", shape.x, shape.y, computeSystem.canTuneWorkgroup(computeData.params.blackHoleType) && tuner.isTuned(BlackHoleComputeSystem::getKernelName(computeData.params.blackHoleType)) ? " (tuned)" : "");
+			if (tuner.isTuning()) {
+				ImGui::ProgressBar(tuner.getTuningProgress(), ImVec2(-1.f, 0.f), "Tuning");
+			}
+			else if (!computeSystem.canTuneWorkgroup(computeData.params.blackHoleType)) {
+				ImGui::Text("Work group size is baked into the shader, recompile it to tune");
+			}
+			else if (stats.timestampsSupported && ImGui::Button("Tune Work Group Size")) {
+				computeSystem.startWorkgroupTuning(computeData.params.blackHoleType);
+			}
+
+			ImGui::Separator();
+			TileSchedulerSettings& tileSettings = tileScheduler.getSettings();
+			const TileSchedulerStats& tileStats = tileScheduler.getStats();
+			ImGui::SliderInt("Tiles Per Dispatch", &tileSettings.tilesPerDispatch, 0, tileStats.totalTiles);
+			ImGui::SliderFloat("Centre Priority", &tileSettings.centreWeight, 0.f, 2.f);
+			ImGui::SliderFloat("Variance Priority", &tileSettings.varianceWeight, 0.f, 2.f);
+			ImGui::Text("Tiles: %d active, %d dispatched, %d total", tileStats.activeTiles, tileStats.dispatchedTiles, tileStats.totalTiles);
+			ImGui::Text("Completed: %.1f%%", tileStats.completedFraction * 100.f);
 		}
 		
 
@@ -6,6 +6,7 @@
 #include "narwhal_game_object.hpp"
 #include "narwhal_descriptors.hpp"
 #include "narwhal_frame_info.hpp"
+#include "systems/black_hole_present_system.hpp"
 
 
 //std
@@ -18,6 +19,8 @@ namespace narwhal {
 
 
 	class NarwhalImgui;
+	class BlackHoleComputeSystem;
+	class BlackHoleTileScheduler;
 	class BlackHoleApp
 	{
 	public:
@@ -36,21 +39,26 @@ namespace narwhal {
 
 	private:
 
-		void renderImgui(NarwhalImgui& narwhalImgui, VkCommandBuffer commandBuffer);
+		void renderImgui(NarwhalImgui& narwhalImgui, VkCommandBuffer commandBuffer, BlackHoleComputeSystem& computeSystem, BlackHoleTileScheduler& tileScheduler);
+		VkExtent2D getTraceExtent(VkExtent2D windowExtent) const;
+		// Moves the render scale towards the one that would have hit the target trace time
+		void updateAutoRenderScale(float traceTime);
+		// Lowers the render scale when growing the trace would go over the device local memory budget
+		void fitRenderScaleToBudget(VkExtent2D windowExtent, VkExtent2D traceExtent);
 
 
 		NarwhalWindow narwhalWindow {WIDTH,HEIGHT,"Narwhal Engine V0.1"};
 		NarwhalDevice narwhalDevice {narwhalWindow};
 		NarwhalRenderer narwhalRenderer {narwhalWindow,narwhalDevice};
 
-		std::unique_ptr<NarwhalDescriptorPool> globalPool {};
+		NarwhalDescriptorAllocator globalDescriptorAllocator {narwhalDevice}; // Grows on its own when a new set doesnt fit
 
-		VkFence fence;
 		BlackHoleComputeData computeData;
 		BlackHoleParameters blackHoleParameters;
 		InitParameters initParameters;
 
 		bool showImgui = true;
+		bool screenshotRequested = false; // Picked up by the next graphics frame
 		bool orbitCamera = false;
 		int orbitAxis = 0; //0: x, 1: y, 2: z
 		glm::vec3 orbitOffset= glm::vec3(0,0,0);
@@ -60,6 +68,14 @@ namespace narwhal {
 		float schwarzchildFrameThreshold = .99f;
 		float kerrFrameThreshold = .80f;
 		int percentageCheckInterval = 0;
+		PresentSwapPolicy presentPolicy = PresentSwapPolicy::OnThreshold;
+		float presentBlendFactor = .25f;
+		float renderScale = 1.f; // Trace resolution relative to the window
+		float pendingRenderScale = 1.f; // What the slider shows while dragging
+		bool autoRenderScale = false;
+		bool budgetLimited = false; // Last render scale increase got cut down to fit the memory budget
+		bool idleWhenConverged = true; // Stop tracing and presenting once converged until input or a change
+		float targetTraceTime = 2.f; // Seconds from init to a finished trace the auto scale aims for
 
 		const char* renderTextures[4] = { "Color","Position","Direction","IsComplete"};
 		int renderTextureIndex = 0;
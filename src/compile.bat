@@ -1,7 +1,8 @@
 @echo on
  cd ../data/shaders
  
-for %%f in (*.frag,*.vert) do (
-	%VULKAN_SDK%\Bin\glslc.exe "%%~f" -o "%%~f.spv"
+for %%f in (*.frag,*.vert,*.comp) do (
+	%VULKAN_SDK%\Bin\glslc.exe --target-env=vulkan1.1 "%%~f" -o "%%~f.spv"
+	if errorlevel 1 exit /b 1
 )
 cd ../../src
\ No newline at end of file
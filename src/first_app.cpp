@@ -3,6 +3,8 @@
 #include "keyboard_movement_controller.hpp"
 #include "narwhal_camera.hpp"
 #include "narwhal_buffer.hpp"
+#include "narwhal_readback.hpp"
+#include "narwhal_uniform_ring.hpp"
 #include "systems/simple_render_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/narwhal_imgui.hpp"
@@ -34,13 +36,6 @@ namespace narwhal {
 	
 
 	FirstApp::FirstApp() {
-		globalPool = NarwhalDescriptorPool::Builder(narwhalDevice)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.setMaxSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT*2)
-			.build();
-		
-			
 		loadGameObjects();
 	}
 
@@ -56,26 +51,15 @@ namespace narwhal {
 			narwhalRenderer.getImageCount() };
 
 
-		// Load fence
-		VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-		vkCreateFence(narwhalDevice.device(), &fenceInfo, nullptr, &fence);
-		
-		std::vector<std::unique_ptr<NarwhalBuffer>> uboBuffers(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
+		// Every frame's GlobalUbo goes into its own region of one mapped buffer
+		NarwhalUniformRing uniformRing{ narwhalDevice, sizeof(GlobalUbo), NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT };
 		std::vector<std::unique_ptr<NarwhalBuffer>> storageBuffers(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
-		//make staging NarwhalBuffer
-		std::vector<std::unique_ptr<NarwhalBuffer>> stagingBuffers(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
 		
 		
 		
 		const int MAX_OBJECTS = 10000;
-		for (int i = 0; i < uboBuffers.size(); i++) {
-			uboBuffers[i] = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(GlobalUbo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-			
-			uboBuffers[i]->map();
-		}
 		for (int i = 0; i < storageBuffers.size(); i++) {
-			storageBuffers[i] = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(ComputeTestData)*MAX_OBJECTS, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |VK_MEMORY_PROPERTY_HOST_COHERENT_BIT); //Needs to be coherent since if we want to write from the gpu, then we need to 
-			stagingBuffers[i] = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(ComputeTestData)*MAX_OBJECTS, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ); 
+			storageBuffers[i] = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(ComputeTestData)*MAX_OBJECTS, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |VK_MEMORY_PROPERTY_HOST_COHERENT_BIT); //Needs to be coherent since if we want to write from the gpu, then we need to 
 			
 			storageBuffers[i]->map();
 			
@@ -83,7 +67,7 @@ namespace narwhal {
 		}
 		
 		auto globalSetLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
 			.build();
 
 		auto computeSetLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
@@ -92,18 +76,14 @@ namespace narwhal {
 			
 		//TODO: write to computesetLayout
 		
-		std::vector<VkDescriptorSet> globalDescriptorSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
+		// Shared by every frame, only the dynamic offset changes
+		VkDescriptorSet globalDescriptorSet;
 		std::vector<VkDescriptorSet> computeDescriptorSets(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
-		for (int i = 0; i < globalDescriptorSets.size(); i++) {
-
-
-			
-			auto uboBufferInfo = uboBuffers[i]->descriptorInfo();
-			
-			NarwhalDescriptorWriter(*globalSetLayout, *globalPool)
-				.writeBuffer(0, &uboBufferInfo)
-				
-				.build(globalDescriptorSets[i]);
+		auto uboBufferInfo = uniformRing.descriptorInfo(sizeof(GlobalUbo));
+		if (!NarwhalDescriptorWriter(*globalSetLayout, globalDescriptorAllocator)
+			.writeBuffer(0, &uboBufferInfo)
+			.build(globalDescriptorSet)) {
+			throw std::runtime_error("failed to allocate descriptor set!");
 		}
 
 		for (int i = 0; i < computeDescriptorSets.size(); i++) {
@@ -111,9 +91,11 @@ namespace narwhal {
 			auto storageBufferInfo = storageBuffers[i]->descriptorInfo();
 			
 
-			NarwhalDescriptorWriter(*computeSetLayout, *globalPool)
+			if (!NarwhalDescriptorWriter(*computeSetLayout, globalDescriptorAllocator)
 				.writeBuffer(0, &storageBufferInfo)
-				.build(computeDescriptorSets[i]);
+				.build(computeDescriptorSets[i])) {
+				throw std::runtime_error("failed to allocate descriptor set!");
+			}
 		}
 
 		ComputeTestSystem computeTestSystem{ narwhalDevice, narwhalRenderer.getSwapChainRenderPass(), computeSetLayout->getDescriptorSetLayout()};
@@ -129,11 +111,14 @@ namespace narwhal {
 
 		//std::cout << "maxPushConstantSize = " << narwhalDevice.properties.limits.maxPushConstantsSize << std::endl; 
 
+		NarwhalReadback readback{ narwhalDevice };
+
 		auto currentTime = std::chrono::high_resolution_clock::now();
 
 		while (!narwhalWindow.shouldClose())
 		{
 			glfwPollEvents();
+			readback.update();
 
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
@@ -152,35 +137,29 @@ namespace narwhal {
 
 			if (auto commandBuffer = narwhalRenderer.beginFrame()) { //Will return a null ptr if swap chain needs to be recreated
 				int frameIndex = narwhalRenderer.getFrameIndex();
-				FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSets[frameIndex],computeDescriptorSets[frameIndex],gameObjects,fence};
+				FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSet,computeDescriptorSets[frameIndex],gameObjects};
 
 				//Update
 				GlobalUbo ubo{};
 				ubo.projection = camera.getProjection();
 				ubo.view= camera.getView();
 				ubo.inverseView = camera.getInverseView();
-				uboBuffers[frameIndex]->writeToBuffer(&ubo);
-				uboBuffers[frameIndex]->flush();
 				pointLightSystem.update(frameInfo,ubo);
+				// beginFrame waited on this frame slot, the lights are in so the ubo is final
+				uniformRing.beginFrame(frameIndex);
+				frameInfo.globalUboOffset = uniformRing.push(ubo);
 
 				// Compute Shader
 				computeTestSystem.render(frameInfo);
 				
-				VkBufferCopy copyRegion = {
-					0, // VkDeviceSize    srcOffset
-					0, // VkDeviceSize    dstOffset
-					sizeof(ComputeTestData)* MAX_OBJECTS // VkDeviceSize    size
-				};
-				
-				vkCmdCopyBuffer(commandBuffer, storageBuffers[frameIndex]->getBuffer(), storageBuffers[frameIndex]->getBuffer(), 1, &copyRegion);
-				
-				void* data;
-				vkMapMemory(narwhalDevice.device(), storageBuffers[frameIndex]->getMemory(), 0, sizeof(ComputeTestData)* MAX_OBJECTS, 0, &data);
-				ComputeTestData* computeData = (ComputeTestData*)data;
-				for (int i = 0; i < 2; i++) {
-					std::cout << "computeData[" << i << "].position = " << computeData[i].pixelData.x << " " << computeData[i].pixelData.y << " " << computeData[i].pixelData.z << std::endl;
-				}
-				vkUnmapMemory(narwhalDevice.device(), storageBuffers[frameIndex]->getMemory());
+				// Only the first couple of entries get printed, no need to copy the whole buffer back
+				readback.readBuffer(commandBuffer, NarwhalQueueType::Graphics, storageBuffers[frameIndex]->getBuffer(), 0, sizeof(ComputeTestData) * 2,
+					[](const void* data, VkDeviceSize size) {
+						const ComputeTestData* computeData = static_cast<const ComputeTestData*>(data);
+						for (int i = 0; i < 2; i++) {
+							std::cout << "computeData[" << i << "].position = " << computeData[i].pixelData.x << " " << computeData[i].pixelData.y << " " << computeData[i].pixelData.z << std::endl;
+						}
+					});
 				
 				
 				
@@ -203,6 +182,7 @@ namespace narwhal {
 
 				narwhalRenderer.endSwapChainRenderPass(commandBuffer);
 				narwhalRenderer.endFrame();
+				readback.submitted(NarwhalQueueType::Graphics, narwhalRenderer.getLastSubmission());
 			}
 		}
 
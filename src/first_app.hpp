@@ -35,9 +35,8 @@ namespace narwhal {
 		NarwhalRenderer narwhalRenderer{ narwhalWindow, narwhalDevice };
 		
 		// note: order of declarations matters
-		std::unique_ptr<NarwhalDescriptorPool> globalPool{};
+		NarwhalDescriptorAllocator globalDescriptorAllocator{ narwhalDevice };
 		NarwhalGameObject::Map gameObjects;
-		VkFence fence;
 		
 	
 	};
@@ -8,7 +8,17 @@ namespace narwhal {
 	NarwhalImage::NarwhalImage(NarwhalDevice& device, std::string path, VkFormat imageFormat)
 		: narwhalDevice(device),height(0), width(0), imageFormat(imageFormat), path(path)
 	{
-		createImage();
+		NarwhalUploadBatch uploadBatch{ narwhalDevice };
+		createImage(uploadBatch);
+		uploadBatch.finish();
+		createImageView();
+		createSampler();
+	}
+
+	NarwhalImage::NarwhalImage(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, std::string path, VkFormat imageFormat)
+		: narwhalDevice(device), height(0), width(0), imageFormat(imageFormat), path(path)
+	{
+		createImage(uploadBatch);
 		createImageView();
 		createSampler();
 	}
@@ -18,7 +28,7 @@ namespace narwhal {
 		destroy();
 	}
 
-	void NarwhalImage::createImage()
+	void NarwhalImage::createImage(NarwhalUploadBatch& uploadBatch)
 	{
 		//First we load the image
 
@@ -35,15 +45,6 @@ namespace narwhal {
 		}
 		
 
-		//Create a staging buffer
-		NarwhalBuffer stagingBuffer(narwhalDevice, imageSize,1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		stagingBuffer.map(imageSize, 0);
-		stagingBuffer.writeToBuffer(pixels, imageSize, 0);
-		stagingBuffer.unmap();
-
-		//Clear the pixels
-		stbi_image_free(pixels);
-
 		//Create the image
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -63,31 +64,13 @@ namespace narwhal {
 		if (vkCreateImage(narwhalDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create image: " + path);
 		}
-		// Get the memory requirements for the image
-		VkMemoryRequirements memoryRequirements;
-		vkGetImageMemoryRequirements(narwhalDevice.device(), image, &memoryRequirements);
+		imageAllocation = narwhalDevice.getAllocator().allocateImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, NarwhalMemoryCategory::Textures);
 
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = narwhalDevice.findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		//Staging, copy and both transitions all go into the batch
+		uploadBatch.uploadImage(pixels, imageSize, image, width, height);
 
-		if (vkAllocateMemory(narwhalDevice.device(), &memoryAllocateInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate image memory: " + path);
-		}
-
-		if (vkBindImageMemory(narwhalDevice.device(), image, imageMemory, 0) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to bind image: "+path);
-		}
-
-		//Transition the image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-		narwhalDevice.transitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		//Copy the buffer to the image
-		narwhalDevice.copyBufferToImage(stagingBuffer.getBuffer(), image, width, height,1);
-		//Transition the image to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		narwhalDevice.transitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		
+		//Clear the pixels, the batch keeps its own copy
+		stbi_image_free(pixels);
 	}
 
 	void NarwhalImage::createImageView()
@@ -150,7 +133,7 @@ namespace narwhal {
 	{
 		vkDestroyImageView(narwhalDevice.device(), imageView, nullptr);
 		vkDestroyImage(narwhalDevice.device(), image, nullptr);
-		vkFreeMemory(narwhalDevice.device(), imageMemory, nullptr);
+		narwhalDevice.getAllocator().free(imageAllocation);
 		vkDestroySampler(narwhalDevice.device(), sampler, nullptr);
 	}
 }
\ No newline at end of file
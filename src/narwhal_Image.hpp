@@ -1,5 +1,6 @@
 #pragma once
 #include "narwhal_device.hpp"
+#include "narwhal_upload_batch.hpp"
 
 #include <vulkan/vulkan.hpp>
 
@@ -12,13 +13,19 @@ namespace narwhal {
 	{
 	public:
 		NarwhalImage(NarwhalDevice& device, std::string path, VkFormat imageFormat= VK_FORMAT_R8G8B8A8_SRGB);
+		// Records the upload into a shared batch, the image is only usable after the batch is flushed
+		NarwhalImage(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, std::string path, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB);
 		~NarwhalImage();
 
-		void createImage();
+		NarwhalImage(const NarwhalImage&) = delete;
+		NarwhalImage& operator=(const NarwhalImage&) = delete;
+
+		void createImage(NarwhalUploadBatch& uploadBatch);
 		void createImageView();
 		void createSampler();
 
 		VkDescriptorImageInfo getDescriptorImageInfo();
+		VkImage getImage() { return image; };
 	private:
 		
 		
@@ -33,7 +40,7 @@ namespace narwhal {
 
 		VkImage image = nullptr;
 		VkImageView imageView = nullptr;
-		VkDeviceMemory imageMemory = nullptr;
+		NarwhalAllocation imageAllocation{};
 		VkSampler sampler = nullptr;
 	};
 }
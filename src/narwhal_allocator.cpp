@@ -0,0 +1,464 @@
+#include "narwhal_allocator.hpp"
+
+#include "narwhal_device.hpp"
+
+//std
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+
+namespace narwhal {
+	struct NarwhalMemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+		uint32_t memoryType = 0;
+		uint32_t poolIndex = 0;
+		bool linear = false;
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize linearOffset = 0; // Linear blocks only
+		std::vector<std::set<VkDeviceSize>> freeLists; // Buddy blocks only, free offsets per order, order 0 is MIN_ALLOCATION_SIZE
+	};
+
+	const char* getMemoryCategoryName(NarwhalMemoryCategory category)
+	{
+		switch (category) {
+		case NarwhalMemoryCategory::RayState: return "Ray State";
+		case NarwhalMemoryCategory::Textures: return "Textures";
+		case NarwhalMemoryCategory::Meshes: return "Meshes";
+		case NarwhalMemoryCategory::Uniforms: return "Uniforms";
+		case NarwhalMemoryCategory::Staging: return "Staging";
+		case NarwhalMemoryCategory::SwapChain: return "Swap Chain";
+		case NarwhalMemoryCategory::UI: return "UI";
+		default: return "Other";
+		}
+	}
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static uint32_t orderOf(VkDeviceSize size)
+	{
+		uint32_t order = 0;
+		while ((NarwhalAllocator::MIN_ALLOCATION_SIZE << order) < size) order++;
+		return order;
+	}
+
+	NarwhalAllocator::NarwhalAllocator(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+		vkGetPhysicalDeviceMemoryProperties(narwhalDevice.getPhysicalDevice(), &memoryProperties);
+		nonCoherentAtomSize = narwhalDevice.getLimits().nonCoherentAtomSize;
+
+		blockSizes.resize(memoryProperties.memoryTypeCount);
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			// Small heaps like a 256MB bar window shouldnt be eaten by a couple of blocks
+			VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+			VkDeviceSize blockSize = MAX_BLOCK_SIZE;
+			while (blockSize > heapSize / 8 && blockSize > MIN_ALLOCATION_SIZE * 1024) blockSize /= 2;
+			blockSizes[i] = blockSize;
+		}
+
+		pools.resize(memoryProperties.memoryTypeCount * 4);
+		dedicatedStats.resize(memoryProperties.memoryHeapCount);
+	}
+
+	NarwhalAllocator::~NarwhalAllocator()
+	{
+		for (Pool& pool : pools) {
+			for (auto& block : pool.blocks) {
+				destroyBlock(*block);
+			}
+		}
+	}
+
+	NarwhalAllocation NarwhalAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, NarwhalMemoryCategory category, NarwhalAllocationStrategy strategy)
+	{
+		VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.buffer = buffer;
+
+		VkMemoryDedicatedRequirements dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicatedRequirements;
+		vkGetBufferMemoryRequirements2(narwhalDevice.device(), &requirementsInfo, &requirements);
+
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer = buffer;
+
+		bool prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+		NarwhalAllocation allocation = allocate(requirements.memoryRequirements, prefersDedicated, dedicatedInfo, properties, strategy, false);
+		if (vkBindBufferMemory(narwhalDevice.device(), buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+			free(allocation);
+			throw std::runtime_error("failed to bind buffer memory!");
+		}
+		trackAllocation(allocation, category);
+		return allocation;
+	}
+
+	NarwhalAllocation NarwhalAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags properties, NarwhalMemoryCategory category, NarwhalAllocationStrategy strategy)
+	{
+		VkImageMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.image = image;
+
+		VkMemoryDedicatedRequirements dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicatedRequirements;
+		vkGetImageMemoryRequirements2(narwhalDevice.device(), &requirementsInfo, &requirements);
+
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.image = image;
+
+		bool prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+		NarwhalAllocation allocation = allocate(requirements.memoryRequirements, prefersDedicated, dedicatedInfo, properties, strategy, true);
+		if (vkBindImageMemory(narwhalDevice.device(), image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+			free(allocation);
+			throw std::runtime_error("failed to bind image memory!");
+		}
+		trackAllocation(allocation, category);
+		return allocation;
+	}
+
+	NarwhalAllocation NarwhalAllocator::allocate(const VkMemoryRequirements& requirements, bool prefersDedicated, const VkMemoryDedicatedAllocateInfo& dedicatedInfo,
+		VkMemoryPropertyFlags properties, NarwhalAllocationStrategy strategy, bool isImage)
+	{
+		uint32_t memoryType = narwhalDevice.findMemoryType(requirements.memoryTypeBits, properties);
+		VkDeviceSize size = requirements.size;
+		VkDeviceSize alignment = requirements.alignment;
+		// Flush and invalidate work on whole atoms, keep them from spilling into the neighbours
+		if (isNonCoherent(memoryType)) {
+			size = alignUp(size, nonCoherentAtomSize);
+			alignment = std::max(alignment, nonCoherentAtomSize);
+		}
+
+		bool linear = strategy == NarwhalAllocationStrategy::Linear;
+		// Buddy ranges round up to a power of two, past a quarter block that wastes more than a dedicated allocation costs
+		VkDeviceSize maxSize = linear ? blockSizes[memoryType] : blockSizes[memoryType] / 4;
+		if (strategy == NarwhalAllocationStrategy::Dedicated || prefersDedicated || size > maxSize) {
+			// A dedicated allocation has to be exactly the resource's size, it has no neighbours to spill into anyway
+			return allocateDedicated(memoryType, requirements.size, dedicatedInfo);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		uint32_t poolIndex = memoryType * 4 + (isImage ? 2 : 0) + (linear ? 1 : 0);
+		NarwhalAllocation allocation{};
+		for (auto& block : pools[poolIndex].blocks) {
+			if (allocateFromBlock(*block, size, alignment, allocation)) return allocation;
+		}
+
+		NarwhalMemoryBlock& block = createBlock(memoryType, poolIndex, linear);
+		if (!allocateFromBlock(block, size, alignment, allocation)) {
+			throw std::runtime_error("failed to sub-allocate from a new memory block!");
+		}
+		return allocation;
+	}
+
+	NarwhalAllocation NarwhalAllocator::allocateDedicated(uint32_t memoryType, VkDeviceSize size, const VkMemoryDedicatedAllocateInfo& dedicatedInfo)
+	{
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.pNext = &dedicatedInfo;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		NarwhalAllocation allocation{};
+		if (vkAllocateMemory(narwhalDevice.device(), &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate dedicated memory!");
+		}
+		allocation.size = size;
+		allocation.memoryType = memoryType;
+		if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			vkMapMemory(narwhalDevice.device(), allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		NarwhalHeapStats& stats = dedicatedStats[memoryProperties.memoryTypes[memoryType].heapIndex];
+		stats.dedicatedBytes += size;
+		stats.dedicatedCount++;
+		return allocation;
+	}
+
+	void NarwhalAllocator::trackAllocation(NarwhalAllocation& allocation, NarwhalMemoryCategory category)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		allocation.category = category;
+		NarwhalCategoryStats& stats = categoryStats[static_cast<size_t>(category)];
+		stats.bytes += allocation.size;
+		stats.count++;
+	}
+
+	void NarwhalAllocator::trackExternal(NarwhalMemoryCategory category, VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		NarwhalCategoryStats& stats = categoryStats[static_cast<size_t>(category)];
+		stats.bytes += size;
+		stats.count++;
+	}
+
+	void NarwhalAllocator::untrackExternal(NarwhalMemoryCategory category, VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		NarwhalCategoryStats& stats = categoryStats[static_cast<size_t>(category)];
+		stats.bytes -= size;
+		stats.count--;
+	}
+
+	void NarwhalAllocator::free(NarwhalAllocation& allocation)
+	{
+		if (!allocation.isValid()) return;
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			NarwhalCategoryStats& stats = categoryStats[static_cast<size_t>(allocation.category)];
+			stats.bytes -= allocation.size;
+			stats.count--;
+		}
+
+		if (allocation.block == nullptr) {
+			// Freeing implicitly unmaps
+			vkFreeMemory(narwhalDevice.device(), allocation.memory, nullptr);
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			NarwhalHeapStats& stats = dedicatedStats[memoryProperties.memoryTypes[allocation.memoryType].heapIndex];
+			stats.dedicatedBytes -= allocation.size;
+			stats.dedicatedCount--;
+		}
+		else {
+			std::lock_guard<std::mutex> lock{ mutex };
+			NarwhalMemoryBlock& block = *allocation.block;
+			freeToBlock(block, allocation);
+
+			// Every pool keeps one block so a free and allocate pair doesnt go to the driver each time
+			auto& blocks = pools[block.poolIndex].blocks;
+			if (block.allocationCount == 0 && blocks.size() > 1) {
+				destroyBlock(block);
+				blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&block](const auto& other) { return other.get() == &block; }));
+			}
+		}
+		allocation = {};
+	}
+
+	NarwhalMemoryBlock& NarwhalAllocator::createBlock(uint32_t memoryType, uint32_t poolIndex, bool linear)
+	{
+		auto block = std::make_unique<NarwhalMemoryBlock>();
+		block->size = blockSizes[memoryType];
+		block->memoryType = memoryType;
+		block->poolIndex = poolIndex;
+		block->linear = linear;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block->size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		if (vkAllocateMemory(narwhalDevice.device(), &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate memory block!");
+		}
+		// Mapped once for its whole life, memory cant be mapped twice so resources only ever get pointers into this
+		if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			vkMapMemory(narwhalDevice.device(), block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+		}
+
+		if (!linear) {
+			uint32_t maxOrder = orderOf(block->size);
+			block->freeLists.resize(maxOrder + 1);
+			block->freeLists[maxOrder].insert(0);
+		}
+
+		pools[poolIndex].blocks.push_back(std::move(block));
+		return *pools[poolIndex].blocks.back();
+	}
+
+	void NarwhalAllocator::destroyBlock(NarwhalMemoryBlock& block)
+	{
+		vkFreeMemory(narwhalDevice.device(), block.memory, nullptr);
+		block.memory = VK_NULL_HANDLE;
+		block.mapped = nullptr;
+	}
+
+	bool NarwhalAllocator::allocateFromBlock(NarwhalMemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, NarwhalAllocation& allocation)
+	{
+		VkDeviceSize offset = 0;
+		if (block.linear) {
+			offset = alignUp(block.linearOffset, alignment);
+			if (offset + size > block.size) return false;
+			block.linearOffset = offset + size;
+			allocation.size = size;
+		}
+		else {
+			// Ranges of an order sit on multiples of their size, so a big enough order is aligned too
+			uint32_t order = orderOf(std::max(size, alignment));
+			uint32_t freeOrder = order;
+			while (freeOrder < block.freeLists.size() && block.freeLists[freeOrder].empty()) freeOrder++;
+			if (freeOrder >= block.freeLists.size()) return false;
+
+			offset = *block.freeLists[freeOrder].begin();
+			block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+			// Split down to the order we need, the upper halves go back on the free lists
+			while (freeOrder > order) {
+				freeOrder--;
+				block.freeLists[freeOrder].insert(offset + (MIN_ALLOCATION_SIZE << freeOrder));
+			}
+			allocation.size = MIN_ALLOCATION_SIZE << order;
+		}
+
+		allocation.memory = block.memory;
+		allocation.offset = offset;
+		allocation.memoryType = block.memoryType;
+		allocation.block = &block;
+		allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+
+		block.allocationCount++;
+		block.usedBytes += allocation.size;
+		return true;
+	}
+
+	void NarwhalAllocator::freeToBlock(NarwhalMemoryBlock& block, const NarwhalAllocation& allocation)
+	{
+		block.allocationCount--;
+		block.usedBytes -= allocation.size;
+
+		if (block.linear) {
+			// Holes in a linear block cant be reused, it starts over once everything in it is gone
+			if (block.allocationCount == 0) block.linearOffset = 0;
+			return;
+		}
+
+		// Merge with the buddy for as long as it's free too
+		VkDeviceSize offset = allocation.offset;
+		uint32_t order = orderOf(allocation.size);
+		uint32_t maxOrder = static_cast<uint32_t>(block.freeLists.size()) - 1;
+		while (order < maxOrder) {
+			VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+			auto it = block.freeLists[order].find(buddy);
+			if (it == block.freeLists[order].end()) break;
+
+			block.freeLists[order].erase(it);
+			offset = std::min(offset, buddy);
+			order++;
+		}
+		block.freeLists[order].insert(offset);
+	}
+
+	bool NarwhalAllocator::isNonCoherent(uint32_t memoryType) const
+	{
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+		return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	VkMappedMemoryRange NarwhalAllocator::getMappedRange(const NarwhalAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		VkDeviceSize allocationEnd = allocation.offset + allocation.size;
+		VkDeviceSize start = allocation.offset + offset;
+		VkDeviceSize end = size == VK_WHOLE_SIZE ? allocationEnd : std::min(start + size, allocationEnd);
+		// Non coherent allocations are atom aligned in offset and size, rounding out stays inside this one. Dedicated ones only in offset
+		start = start / nonCoherentAtomSize * nonCoherentAtomSize;
+		end = alignUp(end, nonCoherentAtomSize);
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = start;
+		// Only dedicated allocations can end off an atom, and they end with their memory
+		range.size = end > allocationEnd ? VK_WHOLE_SIZE : end - start;
+		return range;
+	}
+
+	VkResult NarwhalAllocator::flush(const NarwhalAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (!isNonCoherent(allocation.memoryType)) return VK_SUCCESS;
+		VkMappedMemoryRange range = getMappedRange(allocation, size, offset);
+		return vkFlushMappedMemoryRanges(narwhalDevice.device(), 1, &range);
+	}
+
+	VkResult NarwhalAllocator::invalidate(const NarwhalAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (!isNonCoherent(allocation.memoryType)) return VK_SUCCESS;
+		VkMappedMemoryRange range = getMappedRange(allocation, size, offset);
+		return vkInvalidateMappedMemoryRanges(narwhalDevice.device(), 1, &range);
+	}
+
+	std::vector<NarwhalHeapStats> NarwhalAllocator::getHeapStats()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		std::vector<NarwhalHeapStats> stats = dedicatedStats;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			stats[i].heapSize = memoryProperties.memoryHeaps[i].size;
+		}
+
+		for (const Pool& pool : pools) {
+			for (const auto& block : pool.blocks) {
+				NarwhalHeapStats& heap = stats[memoryProperties.memoryTypes[block->memoryType].heapIndex];
+				heap.blockBytes += block->size;
+				heap.usedBytes += block->usedBytes;
+				heap.blockCount++;
+				heap.allocationCount += block->allocationCount;
+			}
+		}
+		return stats;
+	}
+
+	std::vector<NarwhalHeapBudget> NarwhalAllocator::getHeapBudgets()
+	{
+		std::vector<NarwhalHeapBudget> budgets(memoryProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			budgets[i].flags = memoryProperties.memoryHeaps[i].flags;
+		}
+
+		if (narwhalDevice.hasMemoryBudget()) {
+			// Counts every process and everything the driver allocated, not just what went through here
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2(narwhalDevice.getPhysicalDevice(), &properties);
+
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+				budgets[i].budget = budgetProperties.heapBudget[i];
+				budgets[i].usage = budgetProperties.heapUsage[i];
+				budgets[i].fromDriver = true;
+			}
+			return budgets;
+		}
+
+		// Other processes and the driver need some of the heap too, the extension usually reports around this much
+		std::vector<NarwhalHeapStats> stats = getHeapStats();
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			budgets[i].budget = memoryProperties.memoryHeaps[i].size / 10 * 8;
+			budgets[i].usage = stats[i].blockBytes + stats[i].dedicatedBytes;
+		}
+		return budgets;
+	}
+
+	NarwhalHeapBudget NarwhalAllocator::getDeviceLocalBudget()
+	{
+		std::vector<NarwhalHeapBudget> budgets = getHeapBudgets();
+		NarwhalHeapBudget best{};
+		VkDeviceSize bestSize = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			if ((budgets[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) continue;
+			if (memoryProperties.memoryHeaps[i].size > bestSize) {
+				bestSize = memoryProperties.memoryHeaps[i].size;
+				best = budgets[i];
+			}
+		}
+		return best;
+	}
+
+	std::array<NarwhalCategoryStats, static_cast<size_t>(NarwhalMemoryCategory::Count)> NarwhalAllocator::getCategoryStats()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return categoryStats;
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+//std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace narwhal {
+	class NarwhalDevice;
+	struct NarwhalMemoryBlock;
+
+	enum class NarwhalAllocationStrategy {
+		Buddy, // Power of two ranges that merge back when freed, the default for long lived resources
+		Linear, // Bump allocated, a block only resets once everything in it got freed. For batches that die together like staging
+		Dedicated, // Own vkAllocateMemory
+	};
+
+	// What the memory is for, only used for the stats
+	enum class NarwhalMemoryCategory {
+		RayState, // Trace images and tile buffers, scale with the render resolution
+		Textures,
+		Meshes,
+		Uniforms,
+		Staging,
+		SwapChain,
+		UI,
+		Other,
+		Count
+	};
+
+	const char* getMemoryCategoryName(NarwhalMemoryCategory category);
+
+	// A range of device memory handed out by NarwhalAllocator. Plain value, whoever owns the resource frees it
+	struct NarwhalAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0; // Reserved size, can be more than the resource asked for
+		void* mapped = nullptr; // Host visible memory stays mapped, already offset to this allocation
+		uint32_t memoryType = 0;
+		NarwhalMemoryCategory category = NarwhalMemoryCategory::Other;
+		NarwhalMemoryBlock* block = nullptr; // Null for dedicated allocations
+
+		bool isValid() const { return memory != VK_NULL_HANDLE; }
+	};
+
+	struct NarwhalHeapStats {
+		VkDeviceSize heapSize = 0;
+		VkDeviceSize blockBytes = 0; // Reserved for shared blocks
+		VkDeviceSize usedBytes = 0; // Handed out from those blocks
+		VkDeviceSize dedicatedBytes = 0;
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0; // In shared blocks
+		uint32_t dedicatedCount = 0;
+	};
+
+	struct NarwhalCategoryStats {
+		VkDeviceSize bytes = 0;
+		uint32_t count = 0;
+	};
+
+	// What the driver lets this process use of a heap, from VK_EXT_memory_budget when the device has it.
+	// Without it the budget is a guess at part of the heap and the usage only counts our own allocations
+	struct NarwhalHeapBudget {
+		VkDeviceSize budget = 0;
+		VkDeviceSize usage = 0;
+		VkMemoryHeapFlags flags = 0;
+		bool fromDriver = false;
+	};
+
+	// Sub-allocates buffers and images out of a few big vkAllocateMemory blocks per memory type instead of
+	// one allocation per resource. Buffers and images get separate blocks so bufferImageGranularity never matters
+	class NarwhalAllocator
+	{
+	public:
+		static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64 * 1024 * 1024; // Smaller on small heaps
+		static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+		NarwhalAllocator(NarwhalDevice& device);
+		~NarwhalAllocator();
+
+		NarwhalAllocator(const NarwhalAllocator&) = delete;
+		NarwhalAllocator& operator=(const NarwhalAllocator&) = delete;
+
+		// Allocate and bind. Big resources and ones the driver wants dedicated get their own allocation whatever the strategy
+		NarwhalAllocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, NarwhalMemoryCategory category = NarwhalMemoryCategory::Other,
+			NarwhalAllocationStrategy strategy = NarwhalAllocationStrategy::Buddy);
+		NarwhalAllocation allocateImage(VkImage image, VkMemoryPropertyFlags properties, NarwhalMemoryCategory category = NarwhalMemoryCategory::Other,
+			NarwhalAllocationStrategy strategy = NarwhalAllocationStrategy::Buddy);
+		// Resets the allocation, freeing an empty one does nothing
+		void free(NarwhalAllocation& allocation);
+
+		// Ranges are relative to the allocation and get rounded out to nonCoherentAtomSize
+		VkResult flush(const NarwhalAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult invalidate(const NarwhalAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+		// Memory allocated behind our back, like the imgui backend's font atlas, so it still shows up in the stats
+		void trackExternal(NarwhalMemoryCategory category, VkDeviceSize size);
+		void untrackExternal(NarwhalMemoryCategory category, VkDeviceSize size);
+
+		// One entry per memory heap
+		std::vector<NarwhalHeapStats> getHeapStats();
+		std::vector<NarwhalHeapBudget> getHeapBudgets();
+		// The biggest device local heap, where the trace images live
+		NarwhalHeapBudget getDeviceLocalBudget();
+		std::array<NarwhalCategoryStats, static_cast<size_t>(NarwhalMemoryCategory::Count)> getCategoryStats();
+
+	private:
+		struct Pool {
+			std::vector<std::unique_ptr<NarwhalMemoryBlock>> blocks;
+		};
+
+		NarwhalAllocation allocate(const VkMemoryRequirements& requirements, bool prefersDedicated, const VkMemoryDedicatedAllocateInfo& dedicatedInfo,
+			VkMemoryPropertyFlags properties, NarwhalAllocationStrategy strategy, bool isImage);
+		void trackAllocation(NarwhalAllocation& allocation, NarwhalMemoryCategory category);
+		NarwhalAllocation allocateDedicated(uint32_t memoryType, VkDeviceSize size, const VkMemoryDedicatedAllocateInfo& dedicatedInfo);
+		NarwhalMemoryBlock& createBlock(uint32_t memoryType, uint32_t poolIndex, bool linear);
+		void destroyBlock(NarwhalMemoryBlock& block);
+		bool allocateFromBlock(NarwhalMemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, NarwhalAllocation& allocation);
+		void freeToBlock(NarwhalMemoryBlock& block, const NarwhalAllocation& allocation);
+		VkMappedMemoryRange getMappedRange(const NarwhalAllocation& allocation, VkDeviceSize size, VkDeviceSize offset);
+		bool isNonCoherent(uint32_t memoryType) const;
+
+		NarwhalDevice& narwhalDevice;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize nonCoherentAtomSize;
+		std::vector<VkDeviceSize> blockSizes; // Per memory type
+		std::vector<Pool> pools; // memoryType * 4 + image * 2 + linear
+		std::vector<NarwhalHeapStats> dedicatedStats; // Per heap, only the dedicated fields are used
+		std::array<NarwhalCategoryStats, static_cast<size_t>(NarwhalMemoryCategory::Count)> categoryStats{};
+		std::mutex mutex;
+	};
+}
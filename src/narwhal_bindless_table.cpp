@@ -0,0 +1,150 @@
+#include "narwhal_bindless_table.hpp"
+
+//std
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace narwhal {
+	NarwhalBindlessTable::NarwhalBindlessTable(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+		// Update after bind descriptors have their own, usually much higher, limits
+		VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+		vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &vulkan12Properties;
+		vkGetPhysicalDeviceProperties2(narwhalDevice.getPhysicalDevice(), &properties);
+
+		bufferSlots.capacity = std::min({ MAX_BUFFERS, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+		textureSlots.capacity = std::min({ MAX_TEXTURES, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages });
+
+		VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+		setLayout = NarwhalDescriptorSetLayout::Builder(narwhalDevice)
+			.addBinding(BUFFER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL, bufferSlots.capacity, bindingFlags)
+			.addBinding(TEXTURE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL, textureSlots.capacity,
+				bindingFlags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT)
+			.build();
+
+		// Its own pool, update after bind sets can only come from pools created for them
+		VkDescriptorPoolSize poolSizes[] = {
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferSlots.capacity },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureSlots.capacity },
+		};
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 2;
+		poolInfo.pPoolSizes = poolSizes;
+		if (vkCreateDescriptorPool(narwhalDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+		variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+		variableCountInfo.descriptorSetCount = 1;
+		variableCountInfo.pDescriptorCounts = &textureSlots.capacity;
+
+		VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = &variableCountInfo;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		if (vkAllocateDescriptorSets(narwhalDevice.device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate bindless descriptor set!");
+		}
+	}
+
+	NarwhalBindlessTable::~NarwhalBindlessTable()
+	{
+		vkDestroyDescriptorPool(narwhalDevice.device(), descriptorPool, nullptr);
+	}
+
+	uint32_t NarwhalBindlessTable::acquireSlot(SlotList& slots)
+	{
+		uint32_t index = INVALID_INDEX;
+		if (!slots.freeSlots.empty()) {
+			index = slots.freeSlots.back();
+			slots.freeSlots.pop_back();
+		}
+		else if (slots.next < slots.capacity) {
+			index = slots.next++;
+		}
+		if (index != INVALID_INDEX) slots.liveCount++;
+		return index;
+	}
+
+	void NarwhalBindlessTable::releaseSlot(SlotList& slots, uint32_t index, std::shared_ptr<void> resource)
+	{
+		if (index == INVALID_INDEX) return;
+		// The descriptor itself stays as it is, partially bound lets it go stale as long as nothing indexes it
+		narwhalDevice.getDeletionQueue().retire([this, &slots, index, resource]() {
+			std::lock_guard<std::mutex> lock{ mutex };
+			slots.freeSlots.push_back(index);
+			slots.liveCount--;
+		});
+	}
+
+	uint32_t NarwhalBindlessTable::registerTexture(const VkDescriptorImageInfo& imageInfo)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		uint32_t index = acquireSlot(textureSlots);
+		if (index == INVALID_INDEX) return INVALID_INDEX;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = TEXTURE_BINDING;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(narwhalDevice.device(), 1, &write, 0, nullptr);
+		return index;
+	}
+
+	uint32_t NarwhalBindlessTable::registerBuffer(const VkDescriptorBufferInfo& bufferInfo)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		uint32_t index = acquireSlot(bufferSlots);
+		if (index == INVALID_INDEX) return INVALID_INDEX;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = BUFFER_BINDING;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(narwhalDevice.device(), 1, &write, 0, nullptr);
+		return index;
+	}
+
+	void NarwhalBindlessTable::releaseTexture(uint32_t index, std::shared_ptr<void> resource)
+	{
+		releaseSlot(textureSlots, index, std::move(resource));
+	}
+
+	void NarwhalBindlessTable::releaseBuffer(uint32_t index, std::shared_ptr<void> resource)
+	{
+		releaseSlot(bufferSlots, index, std::move(resource));
+	}
+
+	uint32_t NarwhalBindlessTable::getTextureCount()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return textureSlots.liveCount;
+	}
+
+	uint32_t NarwhalBindlessTable::getBufferCount()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return bufferSlots.liveCount;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "narwhal_descriptors.hpp"
+
+//std
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace narwhal {
+
+	// One global descriptor set every shader can index into. Textures and storage buffers register once and
+	// get a slot, shaders pick them by that index so a draw never needs its own set. Update after bind and
+	// partially bound, registering while frames are in flight is fine and unused slots are never touched
+	class NarwhalBindlessTable
+	{
+	public:
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+		static constexpr uint32_t BUFFER_BINDING = 0;
+		static constexpr uint32_t TEXTURE_BINDING = 1; // Variable count, has to be the last binding
+		static constexpr uint32_t MAX_BUFFERS = 1024; // Clamped to the device limits
+		static constexpr uint32_t MAX_TEXTURES = 4096;
+
+		NarwhalBindlessTable(NarwhalDevice& device);
+		~NarwhalBindlessTable();
+
+		NarwhalBindlessTable(const NarwhalBindlessTable&) = delete;
+		NarwhalBindlessTable& operator=(const NarwhalBindlessTable&) = delete;
+
+		// Returns INVALID_INDEX once the table is full
+		uint32_t registerTexture(const VkDescriptorImageInfo& imageInfo);
+		uint32_t registerBuffer(const VkDescriptorBufferInfo& bufferInfo);
+		// The slot only gets handed out again once every submit that could still index it finished,
+		// the resource behind it is kept alive until then too
+		void releaseTexture(uint32_t index, std::shared_ptr<void> resource = nullptr);
+		void releaseBuffer(uint32_t index, std::shared_ptr<void> resource = nullptr);
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+		VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+		uint32_t getTextureCount();
+		uint32_t getBufferCount();
+
+	private:
+		struct SlotList {
+			uint32_t capacity = 0;
+			uint32_t next = 0; // Slots past this were never used
+			uint32_t liveCount = 0;
+			std::vector<uint32_t> freeSlots;
+		};
+
+		uint32_t acquireSlot(SlotList& slots);
+		void releaseSlot(SlotList& slots, uint32_t index, std::shared_ptr<void> resource);
+
+		NarwhalDevice& narwhalDevice;
+		std::shared_ptr<NarwhalDescriptorSetLayout> setLayout;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		SlotList textureSlots;
+		SlotList bufferSlots;
+		std::mutex mutex; // Guards the slot lists and the set, descriptor updates are externally synchronized
+	};
+}
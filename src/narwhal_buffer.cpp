@@ -35,7 +35,9 @@ namespace narwhal {
         uint32_t instanceCount,
         VkBufferUsageFlags usageFlags,
         VkMemoryPropertyFlags memoryPropertyFlags,
-        VkDeviceSize minOffsetAlignment)
+        VkDeviceSize minOffsetAlignment,
+        NarwhalMemoryCategory category,
+        NarwhalAllocationStrategy strategy)
         : narwhalDevice{ device },
         instanceSize{ instanceSize },
         instanceCount{ instanceCount },
@@ -43,18 +45,20 @@ namespace narwhal {
         memoryPropertyFlags{ memoryPropertyFlags } {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, category, strategy);
     }
 
     NarwhalBuffer::~NarwhalBuffer() {
         unmap();
         vkDestroyBuffer(narwhalDevice.device(), buffer, nullptr);
-        vkFreeMemory(narwhalDevice.device(), memory, nullptr);
+        narwhalDevice.getAllocator().free(allocation);
     }
 
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
      *
+     * @note Host visible memory stays mapped by the allocator, this only points mapped at the range
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -62,20 +66,21 @@ namespace narwhal {
      * @return VkResult of the buffer mapping call
      */
     VkResult NarwhalBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(narwhalDevice.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.isValid() && "Called map on buffer before create");
+        if (allocation.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        mapped = static_cast<char*>(allocation.mapped) + offset;
+        return VK_SUCCESS;
     }
 
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The memory itself stays mapped until the allocator frees it
      */
     void NarwhalBuffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(narwhalDevice.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     /**
@@ -112,12 +117,7 @@ namespace narwhal {
      * @return VkResult of the flush call
      */
     VkResult NarwhalBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(narwhalDevice.device(), 1, &mappedRange);
+        return narwhalDevice.getAllocator().flush(allocation, size, offset);
     }
 
     /**
@@ -132,12 +132,7 @@ namespace narwhal {
      * @return VkResult of the invalidate call
      */
     VkResult NarwhalBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(narwhalDevice.device(), 1, &mappedRange);
+        return narwhalDevice.getAllocator().invalidate(allocation, size, offset);
     }
 
     /**
@@ -12,7 +12,9 @@ namespace narwhal {
             uint32_t instanceCount,
             VkBufferUsageFlags usageFlags,
             VkMemoryPropertyFlags memoryPropertyFlags,
-            VkDeviceSize minOffsetAlignment = 1);
+            VkDeviceSize minOffsetAlignment = 1,
+            NarwhalMemoryCategory category = NarwhalMemoryCategory::Other,
+            NarwhalAllocationStrategy strategy = NarwhalAllocationStrategy::Buddy);
         ~NarwhalBuffer();
 
         NarwhalBuffer(const NarwhalBuffer&) = delete;
@@ -40,7 +42,7 @@ namespace narwhal {
         VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
         VkDeviceSize getBufferSize() const { return bufferSize; }
 
-        VkDeviceMemory getMemory() const {return memory;}
+        const NarwhalAllocation& getAllocation() const { return allocation; }
 
     private:
         static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
@@ -48,7 +50,7 @@ namespace narwhal {
         NarwhalDevice& narwhalDevice;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        NarwhalAllocation allocation{};
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
@@ -0,0 +1,128 @@
+#include "narwhal_command_ring.hpp"
+
+#include "narwhal_device.hpp"
+
+//std
+#include <stdexcept>
+
+
+namespace narwhal {
+
+	NarwhalCommandRing::NarwhalCommandRing(NarwhalDevice& device, NarwhalQueueType queueType, uint32_t queueFamily) : narwhalDevice{ device }, queueType{ queueType }, queueFamily{ queueFamily }
+	{
+		slots.reserve(MAX_SLOTS);
+	}
+
+	NarwhalCommandRing::~NarwhalCommandRing()
+	{
+		waitIdle();
+		for (Slot& slot : slots) {
+			vkDestroyCommandPool(narwhalDevice.device(), slot.commandPool, nullptr); // Frees the command buffer too
+		}
+	}
+
+	uint32_t NarwhalCommandRing::createSlot()
+	{
+		Slot slot{};
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(narwhalDevice.device(), &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create command ring pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = slot.commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(narwhalDevice.device(), &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command ring buffer!");
+		}
+
+		slots.push_back(slot);
+		return static_cast<uint32_t>(slots.size() - 1);
+	}
+
+	bool NarwhalCommandRing::isSlotFree(const Slot& slot)
+	{
+		return !slot.recording && slot.submission.isComplete();
+	}
+
+	VkCommandBuffer NarwhalCommandRing::begin()
+	{
+		uint32_t slotCount = static_cast<uint32_t>(slots.size());
+		uint32_t chosen = UINT32_MAX;
+		for (uint32_t i = 0; i < slotCount; i++) {
+			uint32_t index = (cursor + i) % slotCount;
+			if (isSlotFree(slots[index])) {
+				chosen = index;
+				break;
+			}
+		}
+
+		if (chosen == UINT32_MAX) {
+			if (slotCount < MAX_SLOTS) {
+				chosen = createSlot();
+			}
+			else {
+				// Ring is full of pending work, the slot after the last one handed out is the oldest
+				for (uint32_t i = 0; i < slotCount && chosen == UINT32_MAX; i++) {
+					uint32_t index = (cursor + i) % slotCount;
+					if (!slots[index].recording) chosen = index;
+				}
+				if (chosen == UINT32_MAX) {
+					throw std::runtime_error("every command ring slot is still recording!");
+				}
+				slots[chosen].submission.wait();
+			}
+		}
+
+		Slot& slot = slots[chosen];
+		cursor = (chosen + 1) % static_cast<uint32_t>(slots.size());
+
+		vkResetCommandPool(narwhalDevice.device(), slot.commandPool, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		slot.recording = true;
+		return slot.commandBuffer;
+	}
+
+	NarwhalSubmission NarwhalCommandRing::submit(VkCommandBuffer commandBuffer, const NarwhalSubmission& waitFor, VkPipelineStageFlags waitStage)
+	{
+		uint32_t index = 0;
+		while (index < slots.size() && slots[index].commandBuffer != commandBuffer) index++;
+		if (index == slots.size() || !slots[index].recording) {
+			throw std::runtime_error("command buffer was not begun on this command ring!");
+		}
+		Slot& slot = slots[index];
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+
+		NarwhalSubmitSync sync{};
+		sync.wait(waitFor, waitStage);
+		slot.submission = narwhalDevice.submit(queueType, 1, &commandBuffer, sync);
+		slot.recording = false;
+		return slot.submission;
+	}
+
+	void NarwhalCommandRing::waitIdle()
+	{
+		// Slots share the queue timeline, waiting on each one is cheap once the newest is done
+		for (Slot& slot : slots) {
+			slot.submission.wait();
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "narwhal_timeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+//std
+#include <vector>
+#include <cstdint>
+
+
+namespace narwhal {
+	class NarwhalDevice;
+	enum class NarwhalQueueType;
+
+	// Ring of transient command pools for one thread and one queue. A slot is reused once the queue timeline
+	// passes its submit, so single time submits dont allocate, free or idle the queue
+	class NarwhalCommandRing
+	{
+	public:
+		static constexpr uint32_t MAX_SLOTS = 16; // Past this begin waits on the oldest submit instead of growing
+
+		NarwhalCommandRing(NarwhalDevice& device, NarwhalQueueType queueType, uint32_t queueFamily);
+		~NarwhalCommandRing();
+
+		NarwhalCommandRing(const NarwhalCommandRing&) = delete;
+		NarwhalCommandRing& operator=(const NarwhalCommandRing&) = delete;
+
+		VkCommandBuffer begin();
+		// waitFor chains submits across queues, e.g. a graphics acquire behind a transfer release
+		NarwhalSubmission submit(VkCommandBuffer commandBuffer, const NarwhalSubmission& waitFor = {}, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		// Blocks until every submit from this ring finished
+		void waitIdle();
+
+	private:
+		struct Slot {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			NarwhalSubmission submission{}; // Last submit recorded on this slot, empty if never submitted
+			bool recording = false;
+		};
+
+		uint32_t createSlot();
+		bool isSlotFree(const Slot& slot);
+
+		NarwhalDevice& narwhalDevice;
+		NarwhalQueueType queueType;
+		uint32_t queueFamily;
+
+		std::vector<Slot> slots;
+		uint32_t cursor = 0;
+	};
+}
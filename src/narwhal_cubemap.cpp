@@ -1,21 +1,35 @@
 #include "narwhal_cubemap.hpp"
 #include "narwhal_pipeline.hpp"
 
+//std
+#include <algorithm>
+#include <cmath>
+
 namespace narwhal {
 	NarwhalCubemap::NarwhalCubemap(NarwhalDevice& device, uint32_t width, uint32_t height, std::string& rightFace, std::string& leftFace, std::string& topFace, std::string& bottomFace, std::string& frontFace, std::string& backFace)
 		:narwhalDevice(device), width(width), height(height)
 	{
 		std::vector<std::string> faces={rightFace,leftFace,topFace,bottomFace,frontFace,backFace};
-		createCubemapImage(faces);
+		NarwhalUploadBatch uploadBatch{ narwhalDevice };
+		createCubemapImage(uploadBatch, faces);
+		uploadBatch.finish();
 		createCubemapImageView();
 		createCubemapSampler();
 		
 	}
+	NarwhalCubemap::NarwhalCubemap(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, uint32_t width, uint32_t height, std::string& rightFace, std::string& leftFace, std::string& topFace, std::string& bottomFace, std::string& frontFace, std::string& backFace)
+		:narwhalDevice(device), width(width), height(height)
+	{
+		std::vector<std::string> faces = { rightFace,leftFace,topFace,bottomFace,frontFace,backFace };
+		createCubemapImage(uploadBatch, faces);
+		createCubemapImageView();
+		createCubemapSampler();
+	}
 	NarwhalCubemap::~NarwhalCubemap()
 	{
 		vkDestroyImageView(narwhalDevice.device(), imageView, nullptr);
 		vkDestroyImage(narwhalDevice.device(), image, nullptr);
-		vkFreeMemory(narwhalDevice.device(), imageMemory, nullptr);
+		narwhalDevice.getAllocator().free(imageAllocation);
 		vkDestroySampler(narwhalDevice.device(), sampler, nullptr);
 	}
 	VkDescriptorImageInfo NarwhalCubemap::getDescriptorImageInfo()
@@ -27,7 +41,7 @@ namespace narwhal {
 
 		return imageInfo;
 	}
-	void NarwhalCubemap::createCubemapImage(const std::vector<std::string>& faces)
+	void NarwhalCubemap::createCubemapImage(NarwhalUploadBatch& uploadBatch, const std::vector<std::string>& faces)
 	{
 		int numFaces= faces.size();
 		faceData.resize(numFaces);
@@ -56,11 +70,13 @@ namespace narwhal {
 		imageCreateInfo.extent.width = width;
 		imageCreateInfo.extent.height = height;
 		imageCreateInfo.extent.depth = 1;
-		imageCreateInfo.mipLevels = 1;
+		// Full chain, lensed rays that land far apart on the sky read from the smaller mips
+		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+		imageCreateInfo.mipLevels = mipLevels;
 		imageCreateInfo.arrayLayers = 6;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -68,49 +84,15 @@ namespace narwhal {
 			throw std::runtime_error("Failed to create image");
 		}
 
-		// Get the memory requirements for the image
-		VkMemoryRequirements memoryRequirements;
-		vkGetImageMemoryRequirements(narwhalDevice.device(), image, &memoryRequirements);
-
-		// Allocate memory for the image
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = narwhalDevice.findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		if (vkAllocateMemory(narwhalDevice.device(), &memoryAllocateInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate image memory");
-		}
-
-		// Bind the memory to the image
-		vkBindImageMemory(narwhalDevice.device(), image, imageMemory, 0);
-		
-		//Load the cube faces
-
-
-
-		
-		
+		imageAllocation = narwhalDevice.getAllocator().allocateImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, NarwhalMemoryCategory::Textures);
 		
+		//Load the cube faces, every face shares the batch staging arena and submit
 		for (int i = 0; i < faces.size(); i++)
 		{
-
-			VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands();
-			NarwhalBuffer stagingBuffer{ narwhalDevice,faceData[i].size(),1,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-			stagingBuffer.map();
-			stagingBuffer.writeToBuffer(faceData[i].data(), faceData[i].size());
-
-			//We now prepare the image for copying by transitioning it to the VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL layout.
-			
-			//narwhalDevice.transitionImageLayout(commandBuffer, image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, i, 1);
-			narwhalDevice.transitionImageLayout(commandBuffer, image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, i, 1);
-			narwhalDevice.copyBufferToImage(commandBuffer,stagingBuffer.getBuffer(), image, width, height, 1, i);
-
-			//We then transition the image to the VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL layout, which is the layout that we will use to sample from the image in the shader.
-			stagingBuffer.unmap();
-			narwhalDevice.transitionImageLayout(commandBuffer,image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,i,1);
-			narwhalDevice.endSingleTimeCommands(commandBuffer);
+			uploadBatch.uploadImage(faceData[i].data(), faceData[i].size(), image, width, height, i, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 		}
+		faceData.clear(); //The batch staged its own copy
+		uploadBatch.generateMipmaps(image, VK_FORMAT_R8G8B8A8_UNORM, width, height, mipLevels, 6);
 	}
 	void NarwhalCubemap::createCubemapImageView()
 	{
@@ -121,7 +103,7 @@ namespace narwhal {
 		imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM; //TODO: Maybe change in the future so hdr?
 		imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-		imageViewCreateInfo.subresourceRange.levelCount = 1;
+		imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
 		imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 		imageViewCreateInfo.subresourceRange.layerCount = 6;
 
@@ -147,7 +129,7 @@ namespace narwhal {
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
+		samplerInfo.maxLod = static_cast<float>(mipLevels);
 		
 
 		
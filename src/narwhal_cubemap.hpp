@@ -1,6 +1,7 @@
 #pragma once
 #include "narwhal_device.hpp"
 #include "narwhal_buffer.hpp"
+#include "narwhal_upload_batch.hpp"
 
 #include <vulkan/vulkan.hpp>
 //std
@@ -14,24 +15,29 @@ namespace narwhal {
 	{
 		public:
 		NarwhalCubemap(NarwhalDevice &device, uint32_t width, uint32_t height,std::string&rightFace, std::string&leftFace, std::string&topFace, std::string&bottomFace, std::string&frontFace, std::string&backFace);
+		// All six faces go into the shared batch, usable once it is flushed
+		NarwhalCubemap(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, uint32_t width, uint32_t height, std::string& rightFace, std::string& leftFace, std::string& topFace, std::string& bottomFace, std::string& frontFace, std::string& backFace);
 			
 		~NarwhalCubemap();
 
 		VkDescriptorImageInfo getDescriptorImageInfo();
+		VkImage getImage() { return image; };
+		uint32_t getMipLevels() const { return mipLevels; }
 
 
 		private:
 
-			void createCubemapImage(const std::vector<std::string>& faces);
+			void createCubemapImage(NarwhalUploadBatch& uploadBatch, const std::vector<std::string>& faces);
 			void createCubemapImageView();
 			void createCubemapSampler();
 
 			NarwhalDevice& narwhalDevice;
 			uint32_t width, height;
+			uint32_t mipLevels = 1;
 
 			VkImage image = nullptr;
 			VkImageView imageView = nullptr;
-			VkDeviceMemory imageMemory = nullptr;
+			NarwhalAllocation imageAllocation{};
 			VkSampler sampler = nullptr;
 
 			std::vector<std::vector<uint8_t>> faceData{};
@@ -0,0 +1,73 @@
+#include "narwhal_deletion_queue.hpp"
+
+#include "narwhal_device.hpp"
+
+
+namespace narwhal {
+	static constexpr NarwhalQueueType QUEUE_TYPES[] = { NarwhalQueueType::Graphics, NarwhalQueueType::Compute, NarwhalQueueType::Transfer };
+
+	NarwhalDeletionQueue::NarwhalDeletionQueue(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+	}
+
+	NarwhalDeletionQueue::~NarwhalDeletionQueue()
+	{
+		flush();
+	}
+
+	void NarwhalDeletionQueue::retire(std::function<void()> deleter)
+	{
+		Entry entry{};
+		for (int i = 0; i < 3; i++) {
+			entry.values[i] = narwhalDevice.getTimeline(QUEUE_TYPES[i]).getLastValue();
+		}
+		entry.deleter = std::move(deleter);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		entries.push_back(std::move(entry));
+	}
+
+	bool NarwhalDeletionQueue::isComplete(const Entry& entry)
+	{
+		for (int i = 0; i < 3; i++) {
+			if (!narwhalDevice.getTimeline(QUEUE_TYPES[i]).isComplete(entry.values[i])) return false;
+		}
+		return true;
+	}
+
+	void NarwhalDeletionQueue::collect()
+	{
+		// Deleters run outside the lock, destroying something may retire something else
+		std::deque<Entry> finished;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			while (!entries.empty() && isComplete(entries.front())) {
+				finished.push_back(std::move(entries.front()));
+				entries.pop_front();
+			}
+		}
+		for (Entry& entry : finished) {
+			entry.deleter();
+		}
+	}
+
+	void NarwhalDeletionQueue::flush()
+	{
+		// Loops since a deleter can retire more resources
+		while (true) {
+			for (NarwhalQueueType queueType : QUEUE_TYPES) {
+				narwhalDevice.getTimeline(queueType).waitIdle();
+			}
+
+			std::deque<Entry> finished;
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				finished.swap(entries);
+			}
+			if (finished.empty()) return;
+			for (Entry& entry : finished) {
+				entry.deleter();
+			}
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "narwhal_timeline.hpp"
+
+//std
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+
+namespace narwhal {
+	class NarwhalDevice;
+
+	// Destroys resources once the gpu is done with them instead of idling the device. A retired deleter
+	// remembers how far every queue timeline got at the time and runs once all of them passed that point
+	class NarwhalDeletionQueue
+	{
+	public:
+		NarwhalDeletionQueue(NarwhalDevice& device);
+		~NarwhalDeletionQueue();
+
+		NarwhalDeletionQueue(const NarwhalDeletionQueue&) = delete;
+		NarwhalDeletionQueue& operator=(const NarwhalDeletionQueue&) = delete;
+
+		// Anything submitted before this call may still use the resource, anything after must not
+		void retire(std::function<void()> deleter);
+		// Keeps the object alive until it's safe and lets its destructor do the rest
+		template<typename T>
+		void retire(std::unique_ptr<T> object) {
+			if (!object) return;
+			std::shared_ptr<T> retired = std::move(object);
+			retire([retired]() {});
+		}
+
+		// Runs every deleter whose submits finished, cheap enough to call every frame
+		void collect();
+		// Waits on everything and runs all deleters
+		void flush();
+
+	private:
+		struct Entry {
+			std::array<uint64_t, 3> values; // Last submitted value per queue type
+			std::function<void()> deleter;
+		};
+
+		bool isComplete(const Entry& entry);
+
+		NarwhalDevice& narwhalDevice;
+		std::mutex mutex;
+		std::deque<Entry> entries; // Values only grow, so entries finish in order
+	};
+}
@@ -1,6 +1,9 @@
 #include "narwhal_descriptors.hpp"
 
+#include "utils/utils.hpp"
+
 // std
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -12,7 +15,8 @@ namespace narwhal {
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count) {
+        uint32_t count,
+        VkDescriptorBindingFlags flags) {
         assert(bindings.count(binding) == 0 && "Binding already in use");
         VkDescriptorSetLayoutBinding layoutBinding{};
         layoutBinding.binding = binding;
@@ -20,21 +24,28 @@ namespace narwhal {
         layoutBinding.descriptorCount = count;
         layoutBinding.stageFlags = stageFlags;
         bindings[binding] = layoutBinding;
+        if (flags != 0) {
+            bindingFlags[binding] = flags;
+        }
         return *this;
     }
 
-    std::unique_ptr<NarwhalDescriptorSetLayout> NarwhalDescriptorSetLayout::Builder::build() const {
-        return std::make_unique<NarwhalDescriptorSetLayout>(narwhalDevice, bindings);
+    std::shared_ptr<NarwhalDescriptorSetLayout> NarwhalDescriptorSetLayout::Builder::build() const {
+        return narwhalDevice.getDescriptorLayoutCache().getLayout(bindings, bindingFlags);
     }
     
     // *************** Descriptor Set Layout *********************
 
     NarwhalDescriptorSetLayout::NarwhalDescriptorSetLayout(
-        NarwhalDevice& narwhalDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+        NarwhalDevice& narwhalDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags)
         : narwhalDevice{ narwhalDevice }, bindings{ bindings } {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -42,6 +53,19 @@ namespace narwhal {
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        if (!bindingFlags.empty()) {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+            descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+            for (VkDescriptorBindingFlags flags : setLayoutBindingFlags) {
+                if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) {
+                    descriptorSetLayoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+                }
+            }
+        }
+
         if (vkCreateDescriptorSetLayout(
             narwhalDevice.device(),
             &descriptorSetLayoutInfo,
@@ -49,12 +73,184 @@ namespace narwhal {
             &descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
+
+        if (setLayoutBindings.empty()) return;
+
+        // Every binding reads its descriptors from consecutive NarwhalDescriptorInfo slots
+        std::vector<VkDescriptorUpdateTemplateEntry> templateEntries{};
+        for (auto& binding : setLayoutBindings) {
+            descriptorSlots[binding.binding] = descriptorSlotCount;
+
+            VkDescriptorUpdateTemplateEntry entry{};
+            entry.dstBinding = binding.binding;
+            entry.dstArrayElement = 0;
+            entry.descriptorCount = binding.descriptorCount;
+            entry.descriptorType = binding.descriptorType;
+            entry.offset = descriptorSlotCount * sizeof(NarwhalDescriptorInfo);
+            entry.stride = sizeof(NarwhalDescriptorInfo);
+            templateEntries.push_back(entry);
+
+            descriptorSlotCount += binding.descriptorCount;
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+        templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = descriptorSetLayout;
+
+        if (vkCreateDescriptorUpdateTemplate(narwhalDevice.device(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor update template!");
+        }
     }
 
     NarwhalDescriptorSetLayout::~NarwhalDescriptorSetLayout() {
+        if (updateTemplate != VK_NULL_HANDLE) {
+            vkDestroyDescriptorUpdateTemplate(narwhalDevice.device(), updateTemplate, nullptr);
+        }
         vkDestroyDescriptorSetLayout(narwhalDevice.device(), descriptorSetLayout, nullptr);
     }
 
+    // *************** Descriptor Allocator *********************
+
+    NarwhalDescriptorAllocator::NarwhalDescriptorAllocator(NarwhalDevice& narwhalDevice, uint32_t initialSetsPerPool, std::vector<PoolSizeRatio> poolRatios)
+        : narwhalDevice{ narwhalDevice }, poolRatios{ std::move(poolRatios) }, setsPerPool{ initialSetsPerPool } {}
+
+    NarwhalDescriptorAllocator::~NarwhalDescriptorAllocator() {
+        if (currentPool.pool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(narwhalDevice.device(), currentPool.pool, nullptr);
+        }
+        for (Pool& pool : readyPools) {
+            vkDestroyDescriptorPool(narwhalDevice.device(), pool.pool, nullptr);
+        }
+        for (Pool& pool : fullPools) {
+            vkDestroyDescriptorPool(narwhalDevice.device(), pool.pool, nullptr);
+        }
+    }
+
+    NarwhalDescriptorAllocator::Pool NarwhalDescriptorAllocator::getPool() {
+        if (!readyPools.empty()) {
+            Pool pool = readyPools.back();
+            readyPools.pop_back();
+            return pool;
+        }
+
+        std::vector<VkDescriptorPoolSize> poolSizes{};
+        for (const PoolSizeRatio& ratio : poolRatios) {
+            poolSizes.push_back({ ratio.type, std::max(static_cast<uint32_t>(ratio.ratio * setsPerPool), 1u) });
+        }
+
+        VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolInfo.pPoolSizes = poolSizes.data();
+        descriptorPoolInfo.maxSets = setsPerPool;
+
+        Pool pool{ VK_NULL_HANDLE, setsPerPool };
+        if (vkCreateDescriptorPool(narwhalDevice.device(), &descriptorPoolInfo, nullptr, &pool.pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        stats.poolCount++;
+        stats.setCapacity += setsPerPool;
+        setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+        return pool;
+    }
+
+    VkResult NarwhalDescriptorAllocator::tryAllocate(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) {
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = pool;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
+        allocInfo.descriptorSetCount = 1;
+        return vkAllocateDescriptorSets(narwhalDevice.device(), &allocInfo, &descriptor);
+    }
+
+    bool NarwhalDescriptorAllocator::allocate(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) {
+        if (currentPool.pool == VK_NULL_HANDLE) {
+            currentPool = getPool();
+        }
+
+        VkResult result = tryAllocate(currentPool.pool, descriptorSetLayout, descriptor);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+            // Out of sets or of one descriptor type, move on to a fresh pool and try once more
+            fullPools.push_back(currentPool);
+            currentPool = getPool();
+            result = tryAllocate(currentPool.pool, descriptorSetLayout, descriptor);
+        }
+        if (result != VK_SUCCESS) {
+            return false;
+        }
+
+        stats.setCount++;
+        return true;
+    }
+
+    void NarwhalDescriptorAllocator::reset() {
+        if (currentPool.pool != VK_NULL_HANDLE) {
+            readyPools.push_back(currentPool);
+            currentPool = { VK_NULL_HANDLE, 0 };
+        }
+        readyPools.insert(readyPools.end(), fullPools.begin(), fullPools.end());
+        fullPools.clear();
+        for (Pool& pool : readyPools) {
+            vkResetDescriptorPool(narwhalDevice.device(), pool.pool, 0);
+        }
+        stats.setCount = 0;
+    }
+
+    // *************** Descriptor Set Layout Cache *********************
+
+    bool NarwhalDescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const {
+        if (bindings.size() != other.bindings.size() || flags != other.flags) return false;
+        for (size_t i = 0; i < bindings.size(); i++) {
+            const VkDescriptorSetLayoutBinding& a = bindings[i];
+            const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+            if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t NarwhalDescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const {
+        size_t seed = 0;
+        for (size_t i = 0; i < key.bindings.size(); i++) {
+            const VkDescriptorSetLayoutBinding& binding = key.bindings[i];
+            hashCombine(seed, binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags, key.flags[i]);
+        }
+        return seed;
+    }
+
+    std::shared_ptr<NarwhalDescriptorSetLayout> NarwhalDescriptorLayoutCache::getLayout(
+        const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags) {
+        LayoutKey key{};
+        for (auto& kv : bindings) {
+            key.bindings.push_back(kv.second);
+        }
+        std::sort(key.bindings.begin(), key.bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+        for (auto& binding : key.bindings) {
+            auto flags = bindingFlags.find(binding.binding);
+            key.flags.push_back(flags != bindingFlags.end() ? flags->second : 0);
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto it = layouts.find(key);
+        if (it != layouts.end()) return it->second;
+
+        auto layout = std::make_shared<NarwhalDescriptorSetLayout>(narwhalDevice, bindings, bindingFlags);
+        layouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    size_t NarwhalDescriptorLayoutCache::getLayoutCount() {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return layouts.size();
+    }
+
     // *************** Descriptor Pool Builder *********************
 
     NarwhalDescriptorPool::Builder& NarwhalDescriptorPool::Builder::addPoolSize(
@@ -132,8 +328,8 @@ namespace narwhal {
 
     // *************** Descriptor Writer *********************
 
-    NarwhalDescriptorWriter::NarwhalDescriptorWriter(NarwhalDescriptorSetLayout& setLayout, NarwhalDescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {}
+    NarwhalDescriptorWriter::NarwhalDescriptorWriter(NarwhalDescriptorSetLayout& setLayout, NarwhalDescriptorAllocator& allocator)
+        : setLayout{ setLayout }, allocator{ allocator }, infos(setLayout.getDescriptorSlotCount()) {}
 
     NarwhalDescriptorWriter& NarwhalDescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -145,14 +341,8 @@ namespace narwhal {
             bindingDescription.descriptorCount == 1 &&
             "Binding single descriptor info, but binding expects multiple");
 
-        VkWriteDescriptorSet write{};
-        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write.descriptorType = bindingDescription.descriptorType;
-        write.dstBinding = binding;
-        write.pBufferInfo = bufferInfo;
-        write.descriptorCount = 1;
-
-        writes.push_back(write);
+        infos[setLayout.getDescriptorSlot(binding)].buffer = *bufferInfo;
+        markWritten(binding);
         return *this;
     }
 
@@ -166,20 +356,19 @@ namespace narwhal {
             bindingDescription.descriptorCount == 1 &&
             "Binding single descriptor info, but binding expects multiple");
 
-        VkWriteDescriptorSet write{};
-        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write.descriptorType = bindingDescription.descriptorType;
-        write.dstBinding = binding;
-        write.pImageInfo = imageInfo;
-        write.descriptorCount = 1;
-        //write.dstSet = VK_NULL_HANDLE;
-
-        writes.push_back(write);
+        infos[setLayout.getDescriptorSlot(binding)].image = *imageInfo;
+        markWritten(binding);
         return *this;
     }
 
+    void NarwhalDescriptorWriter::markWritten(uint32_t binding) {
+        if (std::find(writtenBindings.begin(), writtenBindings.end(), binding) == writtenBindings.end()) {
+            writtenBindings.push_back(binding);
+        }
+    }
+
     bool NarwhalDescriptorWriter::build(VkDescriptorSet& set) {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
+        bool success = allocator.allocate(setLayout.getDescriptorSetLayout(), set);
         if (!success) {
             return false;
         }
@@ -188,10 +377,36 @@ namespace narwhal {
     }
 
     void NarwhalDescriptorWriter::overwrite(VkDescriptorSet& set) {
-        for (auto& write : writes) {
+        if (writtenBindings.empty()) return;
+
+        if (writtenBindings.size() == setLayout.bindings.size()) {
+            vkUpdateDescriptorSetWithTemplate(allocator.getDevice().device(), set, setLayout.getUpdateTemplate(), infos.data());
+            return;
+        }
+
+        // Only some bindings, the rest of the set keeps what it had
+        std::vector<VkWriteDescriptorSet> writes{};
+        for (uint32_t binding : writtenBindings) {
+            auto& bindingDescription = setLayout.bindings[binding];
+            NarwhalDescriptorInfo& info = infos[setLayout.getDescriptorSlot(binding)];
+
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             write.dstSet = set;
+            write.descriptorType = bindingDescription.descriptorType;
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            bool isBuffer = bindingDescription.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || bindingDescription.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                || bindingDescription.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || bindingDescription.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            if (isBuffer) {
+                write.pBufferInfo = &info.buffer;
+            }
+            else {
+                write.pImageInfo = &info.image;
+            }
+            writes.push_back(write);
         }
-        vkUpdateDescriptorSets(pool.narwhalDevice.device(), writes.size(), writes.data(), 0, nullptr);
+        vkUpdateDescriptorSets(allocator.getDevice().device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
     }
 
 }  // namespace narwhal
\ No newline at end of file
@@ -4,12 +4,19 @@
 
 // std
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
 
 namespace narwhal {
 
+    // One descriptor in an update template's data, the template reads the member that fits the binding type
+    union NarwhalDescriptorInfo {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+    };
+
     class NarwhalDescriptorSetLayout {
     public:
         class Builder {
@@ -20,30 +27,122 @@ namespace narwhal {
                 uint32_t binding,
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
-                uint32_t count = 1);
-            std::unique_ptr<NarwhalDescriptorSetLayout> build() const;
+                uint32_t count = 1,
+                VkDescriptorBindingFlags bindingFlags = 0);
+            // Identical binding sets share one layout through the device's layout cache
+            std::shared_ptr<NarwhalDescriptorSetLayout> build() const;
 
         private:
             NarwhalDevice& narwhalDevice;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
         };
 
+        // Any update after bind binding makes it an update after bind layout, sets then need a pool created for that
         NarwhalDescriptorSetLayout(
-            NarwhalDevice& narwhalDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            NarwhalDevice& narwhalDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags = {});
         ~NarwhalDescriptorSetLayout();
         NarwhalDescriptorSetLayout(const NarwhalDescriptorSetLayout&) = delete;
         NarwhalDescriptorSetLayout& operator=(const NarwhalDescriptorSetLayout&) = delete;
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+        // Writes every binding in one call, reading NarwhalDescriptorInfos packed in slot order
+        VkDescriptorUpdateTemplate getUpdateTemplate() const { return updateTemplate; }
+        uint32_t getDescriptorSlot(uint32_t binding) const { return descriptorSlots.at(binding); }
+        uint32_t getDescriptorSlotCount() const { return descriptorSlotCount; }
 
     private:
         NarwhalDevice& narwhalDevice;
         VkDescriptorSetLayout descriptorSetLayout;
+        VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE; // Null for a layout without bindings
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+        std::unordered_map<uint32_t, uint32_t> descriptorSlots; // First slot of each binding in the template data
+        uint32_t descriptorSlotCount = 0;
 
         friend class NarwhalDescriptorWriter;
     };
 
+    struct NarwhalDescriptorAllocatorStats {
+        uint32_t poolCount = 0;
+        uint32_t setCount = 0; // Allocated since the last reset
+        uint32_t setCapacity = 0; // maxSets over every pool
+    };
+
+    // Hands out descriptor sets from as many pools as it takes, a full or fragmented pool just means a new one.
+    // Sets are never freed one by one, reset drops every set at once and keeps the pools around for reuse
+    class NarwhalDescriptorAllocator {
+    public:
+        // Descriptors of a type per set in a pool
+        struct PoolSizeRatio {
+            VkDescriptorType type;
+            float ratio;
+        };
+
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        NarwhalDescriptorAllocator(NarwhalDevice& narwhalDevice, uint32_t initialSetsPerPool = 16, std::vector<PoolSizeRatio> poolRatios = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4.f },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f } });
+        ~NarwhalDescriptorAllocator();
+        NarwhalDescriptorAllocator(const NarwhalDescriptorAllocator&) = delete;
+        NarwhalDescriptorAllocator& operator=(const NarwhalDescriptorAllocator&) = delete;
+
+        bool allocate(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor);
+        // Every set from this allocator becomes invalid, only call once the gpu is done with them
+        void reset();
+
+        NarwhalDescriptorAllocatorStats getStats() const { return stats; }
+        NarwhalDevice& getDevice() { return narwhalDevice; }
+
+    private:
+        struct Pool {
+            VkDescriptorPool pool;
+            uint32_t maxSets;
+        };
+
+        Pool getPool();
+        VkResult tryAllocate(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor);
+
+        NarwhalDevice& narwhalDevice;
+        std::vector<PoolSizeRatio> poolRatios;
+        uint32_t setsPerPool; // Doubles with every new pool up to MAX_SETS_PER_POOL
+        Pool currentPool{ VK_NULL_HANDLE, 0 };
+        std::vector<Pool> readyPools; // Reset and empty
+        std::vector<Pool> fullPools;
+        NarwhalDescriptorAllocatorStats stats{};
+    };
+
+    // Owned by the device, hands out the same layout for the same bindings instead of creating a new one every build
+    class NarwhalDescriptorLayoutCache {
+    public:
+        NarwhalDescriptorLayoutCache(NarwhalDevice& narwhalDevice) : narwhalDevice{ narwhalDevice } {}
+        NarwhalDescriptorLayoutCache(const NarwhalDescriptorLayoutCache&) = delete;
+        NarwhalDescriptorLayoutCache& operator=(const NarwhalDescriptorLayoutCache&) = delete;
+
+        std::shared_ptr<NarwhalDescriptorSetLayout> getLayout(const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags = {});
+        size_t getLayoutCount();
+
+    private:
+        // Bindings sorted by index, immutable samplers aren't used so they're not part of the key
+        struct LayoutKey {
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            std::vector<VkDescriptorBindingFlags> flags; // Same order as the bindings
+            bool operator==(const LayoutKey& other) const;
+        };
+        struct LayoutKeyHash {
+            size_t operator()(const LayoutKey& key) const;
+        };
+
+        NarwhalDevice& narwhalDevice;
+        std::unordered_map<LayoutKey, std::shared_ptr<NarwhalDescriptorSetLayout>, LayoutKeyHash> layouts;
+        std::mutex mutex;
+    };
+
     class NarwhalDescriptorPool {
     public:
         class Builder {
@@ -82,24 +181,26 @@ namespace narwhal {
     private:
         NarwhalDevice& narwhalDevice;
         VkDescriptorPool descriptorPool;
-
-        friend class NarwhalDescriptorWriter;
     };
 
     class NarwhalDescriptorWriter {
     public:
-        NarwhalDescriptorWriter(NarwhalDescriptorSetLayout& setLayout, NarwhalDescriptorPool& pool);
+        NarwhalDescriptorWriter(NarwhalDescriptorSetLayout& setLayout, NarwhalDescriptorAllocator& allocator);
 
         NarwhalDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         NarwhalDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
 
         bool build(VkDescriptorSet& set);
+        // A writer that covers every binding goes through the layout's update template
         void overwrite(VkDescriptorSet& set);
 
     private:
+        void markWritten(uint32_t binding);
+
         NarwhalDescriptorSetLayout& setLayout;
-        NarwhalDescriptorPool& pool;
-        std::vector<VkWriteDescriptorSet> writes;
+        NarwhalDescriptorAllocator& allocator;
+        std::vector<NarwhalDescriptorInfo> infos; // One per descriptor slot of the layout
+        std::vector<uint32_t> writtenBindings;
     };
 
 }  // namespace narwhal
\ No newline at end of file
@@ -1,4 +1,8 @@
 #include "narwhal_device.hpp"
+#include "narwhal_descriptors.hpp"
+#include "narwhal_bindless_table.hpp"
+#include "narwhal_pipeline_cache.hpp"
+#include "narwhal_pipeline_compiler.hpp"
 
 // std headers
 #include <cstring>
@@ -57,11 +61,31 @@ namespace narwhal {
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
+		allocator = std::make_unique<NarwhalAllocator>(*this);
+		descriptorLayoutCache = std::make_unique<NarwhalDescriptorLayoutCache>(*this);
+		pipelineCache = std::make_unique<NarwhalPipelineCache>(*this);
+		pipelineCompiler = std::make_unique<NarwhalPipelineCompiler>();
 		createCommandPool();
+		createTimelines();
+		bindlessTable = std::make_unique<NarwhalBindlessTable>(*this);
 	}
 
 	NarwhalDevice::~NarwhalDevice() {
+		pipelineCompiler.reset(); // Joins the workers before anything they build with goes away
+		deletionQueue.reset(); // Released bindless slots go back to the table from here
+		bindlessTable.reset();
+		stagingPool.reset();
+		descriptorLayoutCache.reset();
+		pipelineCache.reset(); // Saves it to disk
+		graphicsCommandRings.clear();
+		computeCommandRings.clear();
+		transferCommandRings.clear();
+		transferTimeline.reset();
+		computeTimeline.reset();
+		graphicsTimeline.reset();
+		vkDestroyCommandPool(device_, computeCommandPool, nullptr);
 		vkDestroyCommandPool(device_, commandPool, nullptr);
+		allocator.reset();
 		vkDestroyDevice(device_, nullptr);
 
 		if (enableValidationLayers) {
@@ -147,7 +171,7 @@ namespace narwhal {
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.computeFamily, indices.transferFamily };
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -162,15 +186,35 @@ namespace narwhal {
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+		VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.timelineSemaphore = VK_TRUE;
+		// Descriptor indexing for the bindless table, isDeviceSuitable made sure it's there
+		vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+		vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+		vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = &vulkan12Features;
 
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+		// Optional, without it the memory budget is estimated from the heap sizes
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		memoryBudgetEnabled = isDeviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (memoryBudgetEnabled) {
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// might not really be necessary anymore because device specific validation layers
 		// have been deprecated
@@ -188,6 +232,8 @@ namespace narwhal {
 
 		vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 		vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+		vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
+		vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
 	}
 
 	void NarwhalDevice::createCommandPool() {
@@ -202,6 +248,23 @@ namespace narwhal {
 		if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create command pool!");
 		}
+
+		VkCommandPoolCreateInfo computePoolInfo = {};
+		computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		computePoolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily;
+		computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(device_, &computePoolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute command pool!");
+		}
+	}
+
+	void NarwhalDevice::createTimelines() {
+		graphicsTimeline = std::make_unique<NarwhalTimeline>(*this);
+		if (hasDedicatedComputeQueue()) computeTimeline = std::make_unique<NarwhalTimeline>(*this);
+		if (hasDedicatedTransferQueue()) transferTimeline = std::make_unique<NarwhalTimeline>(*this);
+		deletionQueue = std::make_unique<NarwhalDeletionQueue>(*this);
+		stagingPool = std::make_unique<NarwhalStagingPool>(*this);
 	}
 
 	void NarwhalDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -220,8 +283,28 @@ namespace narwhal {
 		VkPhysicalDeviceFeatures supportedFeatures;
 		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+		// Timeline semaphores are core in 1.2, every submit signals one
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(device, &deviceProperties);
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &vulkan12Features;
+		bool timelineSupported = false;
+		bool bindlessSupported = false;
+		if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+			vkGetPhysicalDeviceFeatures2(device, &features2);
+			timelineSupported = vulkan12Features.timelineSemaphore;
+			// The mesh renderer reads every material and texture through the bindless table
+			bindlessSupported = vulkan12Features.runtimeDescriptorArray && vulkan12Features.descriptorBindingPartiallyBound
+				&& vulkan12Features.descriptorBindingVariableDescriptorCount && vulkan12Features.shaderSampledImageArrayNonUniformIndexing
+				&& vulkan12Features.shaderStorageBufferArrayNonUniformIndexing && vulkan12Features.descriptorBindingSampledImageUpdateAfterBind
+				&& vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind;
+		}
+
 		return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-			supportedFeatures.samplerAnisotropy;
+			supportedFeatures.samplerAnisotropy && timelineSupported && bindlessSupported;
 	}
 
 	void NarwhalDevice::populateDebugMessengerCreateInfo(
@@ -349,6 +432,42 @@ namespace narwhal {
 		return requiredExtensions.empty();
 	}
 
+	bool NarwhalDevice::isDeviceExtensionSupported(const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	VkQueueFamilyProperties NarwhalDevice::getQueueFamilyProperties(uint32_t queueFamily) {
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		if (queueFamily >= queueFamilyCount) {
+			throw std::runtime_error("invalid queue family index!");
+		}
+		return queueFamilies[queueFamily];
+	}
+
+	VkPhysicalDeviceSubgroupProperties NarwhalDevice::getSubgroupProperties() {
+		VkPhysicalDeviceSubgroupProperties subgroupProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES };
+		VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+		properties2.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+		return subgroupProperties;
+	}
+
 	QueueFamilyIndices NarwhalDevice::findQueueFamilies(VkPhysicalDevice device) {
 		QueueFamilyIndices indices;
 
@@ -360,23 +479,42 @@ namespace narwhal {
 
 		int i = 0;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && !indices.graphicsFamilyHasValue) {
 				indices.graphicsFamily = i;
 				indices.graphicsFamilyHasValue = true;
 			}
 			VkBool32 presentSupport = false;
 			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-			if (queueFamily.queueCount > 0 && presentSupport) {
+			if (queueFamily.queueCount > 0 && presentSupport && !indices.presentFamilyHasValue) {
 				indices.presentFamily = i;
 				indices.presentFamilyHasValue = true;
 			}
-			if (indices.isComplete()) {
-				break;
+			// A compute family without graphics runs on its own hardware queue, so long integrations dont stall the ui
+			if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamilyHasValue) {
+				indices.computeFamily = i;
+				indices.computeFamilyHasValue = true;
+			}
+			// Copy engine, only worth it if it can copy images at any offset
+			VkExtent3D granularity = queueFamily.minImageTransferGranularity;
+			bool anyGranularity = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+			if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && anyGranularity && !indices.transferFamilyHasValue) {
+				indices.transferFamily = i;
+				indices.transferFamilyHasValue = true;
 			}
 
 			i++;
 		}
 
+		// Graphics queues always support compute
+		if (!indices.computeFamilyHasValue && indices.graphicsFamilyHasValue) {
+			indices.computeFamily = indices.graphicsFamily;
+			indices.computeFamilyHasValue = true;
+		}
+		if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue) {
+			indices.transferFamily = indices.graphicsFamily;
+			indices.transferFamilyHasValue = true;
+		}
+
 		return indices;
 	}
 
@@ -441,7 +579,9 @@ namespace narwhal {
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory) {
+		NarwhalAllocation& bufferAllocation,
+		NarwhalMemoryCategory category,
+		NarwhalAllocationStrategy strategy) {
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -452,51 +592,73 @@ namespace narwhal {
 			throw std::runtime_error("failed to create vertex buffer!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		bufferAllocation = allocator->allocateBuffer(buffer, properties, category, strategy);
+	}
 
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
+	NarwhalCommandRing& NarwhalDevice::getCommandRing(NarwhalQueueType queueType) {
+		std::lock_guard<std::mutex> lock{ commandRingMutex };
+		QueueFamilyIndices indices = findPhysicalQueueFamilies();
+		auto* rings = &graphicsCommandRings;
+		uint32_t queueFamily = indices.graphicsFamily;
+		if (queueType == NarwhalQueueType::Compute) {
+			rings = &computeCommandRings;
+			queueFamily = indices.computeFamily;
+		}
+		else if (queueType == NarwhalQueueType::Transfer) {
+			rings = &transferCommandRings;
+			queueFamily = indices.transferFamily;
 		}
 
-		vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+		auto& ring = (*rings)[std::this_thread::get_id()];
+		if (!ring) {
+			ring = std::make_unique<NarwhalCommandRing>(*this, queueType, queueFamily);
+		}
+		return *ring;
 	}
 
-	VkCommandBuffer NarwhalDevice::beginSingleTimeCommands() {
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
-		allocInfo.commandBufferCount = 1;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
-
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VkQueue NarwhalDevice::getQueue(NarwhalQueueType queueType) {
+		if (queueType == NarwhalQueueType::Compute) return computeQueue_;
+		if (queueType == NarwhalQueueType::Transfer) return transferQueue_;
+		return graphicsQueue_;
+	}
 
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-		return commandBuffer;
+	NarwhalTimeline& NarwhalDevice::getTimeline(NarwhalQueueType queueType) {
+		if (queueType == NarwhalQueueType::Compute && computeTimeline) return *computeTimeline;
+		if (queueType == NarwhalQueueType::Transfer && transferTimeline) return *transferTimeline;
+		return *graphicsTimeline;
 	}
 
-	void NarwhalDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer,VkFence fence) {
-		vkEndCommandBuffer(commandBuffer);
+	NarwhalSubmission NarwhalDevice::submit(NarwhalQueueType queueType, uint32_t commandBufferCount, const VkCommandBuffer* commandBuffers, NarwhalSubmitSync sync) {
+		NarwhalTimeline& timeline = getTimeline(queueType);
+
+		std::lock_guard<std::mutex> lock{ queueMutex };
+		uint64_t value = timeline.nextValue();
+		sync.signal(timeline, value);
 
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.commandBufferCount = commandBufferCount;
+		submitInfo.pCommandBuffers = commandBuffers;
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		sync.apply(submitInfo, timelineInfo);
 
-		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
-		vkQueueWaitIdle(graphicsQueue_);
+		if (vkQueueSubmit(getQueue(queueType), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit command buffer!");
+		}
+		return NarwhalSubmission{ &timeline, value };
+	}
 
-		vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+	VkCommandBuffer NarwhalDevice::beginSingleTimeCommands(NarwhalQueueType queueType) {
+		return getCommandRing(queueType).begin();
+	}
+
+	NarwhalSubmission NarwhalDevice::submitSingleTimeCommands(VkCommandBuffer commandBuffer, NarwhalQueueType queueType) {
+		return getCommandRing(queueType).submit(commandBuffer);
+	}
+
+	void NarwhalDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer, NarwhalQueueType queueType) {
+		// Only waits for this submit, not for everything else on the queue
+		submitSingleTimeCommands(commandBuffer, queueType).wait();
 	}
 
 	void NarwhalDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -549,31 +711,19 @@ namespace narwhal {
 		const VkImageCreateInfo& imageInfo,
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
-		VkDeviceMemory& imageMemory) {
+		NarwhalAllocation& imageAllocation,
+		NarwhalMemoryCategory category,
+		NarwhalAllocationStrategy strategy) {
 		if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(device_, image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
-		}
-
-		if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-			throw std::runtime_error("failed to bind image memory!");
-		}
+		imageAllocation = allocator->allocateImage(image, properties, category, strategy);
 	}
 
 	void NarwhalDevice::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerNumber, uint32_t layerCount) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-		transitionImageLayout(commandBuffer, image, format, oldLayout, newLayout);
+		transitionImageLayout(commandBuffer, image, format, oldLayout, newLayout, layerNumber, layerCount);
 		endSingleTimeCommands(commandBuffer);
 	}
 
@@ -1,12 +1,25 @@
 #pragma once
 
 #include "narwhal_window.hpp"
+#include "narwhal_command_ring.hpp"
+#include "narwhal_timeline.hpp"
+#include "narwhal_deletion_queue.hpp"
+#include "narwhal_allocator.hpp"
+#include "narwhal_staging_pool.hpp"
 
 // std lib headers
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace narwhal {
+class NarwhalDescriptorLayoutCache;
+class NarwhalBindlessTable;
+class NarwhalPipelineCache;
+class NarwhalPipelineCompiler;
 
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
@@ -17,11 +30,17 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t computeFamily; // Compute only family when the device has one, graphics family otherwise
+  uint32_t transferFamily; // Transfer only family when the device has one, graphics family otherwise
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool computeFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+enum class NarwhalQueueType { Graphics, Compute, Transfer };
+
 class NarwhalDevice {
  public:
      const bool enablePrintExtension = true;
@@ -42,14 +61,23 @@ class NarwhalDevice {
   NarwhalDevice() = default;
 
   VkCommandPool getCommandPool() { return commandPool; }
+  VkCommandPool getComputeCommandPool() { return computeCommandPool; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue computeQueue() { return computeQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
   VkInstance getInstance() { return instance; }
   VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
   uint32_t getGraphicsQueueFamily() { return findPhysicalQueueFamilies().graphicsFamily; }
+  uint32_t getComputeQueueFamily() { return findPhysicalQueueFamilies().computeFamily; }
+  bool hasDedicatedComputeQueue() { return getComputeQueueFamily() != getGraphicsQueueFamily(); }
+  uint32_t getTransferQueueFamily() { return findPhysicalQueueFamilies().transferFamily; }
+  bool hasDedicatedTransferQueue() { return getTransferQueueFamily() != getGraphicsQueueFamily(); }
   VkPhysicalDeviceLimits getLimits() { return properties.limits; }
+  VkQueueFamilyProperties getQueueFamilyProperties(uint32_t queueFamily);
+  VkPhysicalDeviceSubgroupProperties getSubgroupProperties();
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -63,9 +91,37 @@ class NarwhalDevice {
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
-  VkCommandBuffer beginSingleTimeCommands();
-  void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkFence fence = VK_NULL_HANDLE);
+      NarwhalAllocation &bufferAllocation,
+      NarwhalMemoryCategory category = NarwhalMemoryCategory::Other,
+      NarwhalAllocationStrategy strategy = NarwhalAllocationStrategy::Buddy);
+  // Single time commands come from the calling thread's command ring
+  VkCommandBuffer beginSingleTimeCommands(NarwhalQueueType queueType = NarwhalQueueType::Graphics);
+  NarwhalSubmission submitSingleTimeCommands(VkCommandBuffer commandBuffer, NarwhalQueueType queueType = NarwhalQueueType::Graphics);
+  void endSingleTimeCommands(VkCommandBuffer commandBuffer, NarwhalQueueType queueType = NarwhalQueueType::Graphics); // Submits and waits for it
+  NarwhalCommandRing& getCommandRing(NarwhalQueueType queueType = NarwhalQueueType::Graphics);
+  // Queues are externally synchronized, hold this around any queue call that can race a submit on another thread
+  std::mutex& getQueueMutex() { return queueMutex; }
+  VkQueue getQueue(NarwhalQueueType queueType);
+  // One timeline per queue, types that share a queue share the timeline
+  NarwhalTimeline& getTimeline(NarwhalQueueType queueType);
+  // Every submit goes through here so it signals the next value on the queue's timeline
+  NarwhalSubmission submit(NarwhalQueueType queueType, uint32_t commandBufferCount, const VkCommandBuffer* commandBuffers, NarwhalSubmitSync sync = {});
+  // Runtime rebuilds retire the old resources here instead of calling vkDeviceWaitIdle
+  NarwhalDeletionQueue& getDeletionQueue() { return *deletionQueue; }
+  // All buffer and image memory comes out of here instead of one vkAllocateMemory per resource
+  NarwhalAllocator& getAllocator() { return *allocator; }
+  // Shared staging memory for uploads and readbacks
+  NarwhalStagingPool& getStagingPool() { return *stagingPool; }
+  // Descriptor set layout builders go through here so identical layouts are only created once
+  NarwhalDescriptorLayoutCache& getDescriptorLayoutCache() { return *descriptorLayoutCache; }
+  // Every pipeline is created through this cache, it persists between runs
+  NarwhalPipelineCache& getPipelineCache() { return *pipelineCache; }
+  // Worker threads for pipeline builds, systems queue theirs instead of compiling in the constructor
+  NarwhalPipelineCompiler& getPipelineCompiler() { return *pipelineCompiler; }
+  // Global texture and buffer table, descriptor indexing is required so it always exists
+  NarwhalBindlessTable& getBindlessTable() { return *bindlessTable; }
+  // VK_EXT_memory_budget got enabled, the allocator reads the real heap budgets through it
+  bool hasMemoryBudget() { return memoryBudgetEnabled; }
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t layerNumber=0);
@@ -76,7 +132,9 @@ class NarwhalDevice {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      NarwhalAllocation &imageAllocation,
+      NarwhalMemoryCategory category = NarwhalMemoryCategory::Other,
+      NarwhalAllocationStrategy strategy = NarwhalAllocationStrategy::Buddy);
 
   void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerNumber = 0, uint32_t layerCount = 1);
   void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerNumber = 0, uint32_t layerCount = 1);
@@ -91,6 +149,7 @@ class NarwhalDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createTimelines();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -101,6 +160,7 @@ class NarwhalDevice {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionSupported(const char* extensionName);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -108,14 +168,34 @@ class NarwhalDevice {
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   NarwhalWindow &window;
   VkCommandPool commandPool;
+  VkCommandPool computeCommandPool;
 
   VkDevice device_;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   
   VkQueue presentQueue_;
+  VkQueue computeQueue_;
+  VkQueue transferQueue_;
 
   bool shaderPrintEnabled = false;
+  bool memoryBudgetEnabled = false;
+
+  std::mutex queueMutex;
+  std::unique_ptr<NarwhalTimeline> graphicsTimeline;
+  std::unique_ptr<NarwhalTimeline> computeTimeline; // Null when compute shares the graphics queue
+  std::unique_ptr<NarwhalTimeline> transferTimeline; // Null when transfer shares the graphics queue
+  std::unique_ptr<NarwhalDeletionQueue> deletionQueue;
+  std::unique_ptr<NarwhalAllocator> allocator;
+  std::unique_ptr<NarwhalStagingPool> stagingPool;
+  std::unique_ptr<NarwhalDescriptorLayoutCache> descriptorLayoutCache;
+  std::unique_ptr<NarwhalBindlessTable> bindlessTable;
+  std::unique_ptr<NarwhalPipelineCache> pipelineCache;
+  std::unique_ptr<NarwhalPipelineCompiler> pipelineCompiler;
+  std::mutex commandRingMutex;
+  std::unordered_map<std::thread::id, std::unique_ptr<NarwhalCommandRing>> graphicsCommandRings;
+  std::unordered_map<std::thread::id, std::unique_ptr<NarwhalCommandRing>> computeCommandRings;
+  std::unordered_map<std::thread::id, std::unique_ptr<NarwhalCommandRing>> transferCommandRings;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -44,7 +44,7 @@ namespace narwhal {
 		VkDescriptorSet globalDescriptorSet;
 		VkDescriptorSet computeDescriptorSet;
 		NarwhalGameObject::Map& gameObjects;
-		VkFence computeFence;
+		uint32_t globalUboOffset = 0; // Dynamic offset of this frame's GlobalUbo
 		
 	};
 
@@ -102,12 +102,20 @@ namespace narwhal {
 		float starMultiplier = 1.f;
 	};
 
+	// Whatever changes every batch goes in as push constants, has to match the push block of the update shaders
+	struct BlackHoleComputePush {
+		glm::ivec2 windowSize{ 0 };
+		glm::ivec2 tileCount{ 0 };
+		float time = 0;
+		VkBool32 hardCheck = VK_FALSE;
+		uint32_t frameIndex = 0; // Counts dispatches, filled by the compute system
+		int stepsPerDispatch = 1; // RK4 steps each invocation takes, filled by the compute system
+	};
+
 	struct BlackHoleComputeData
 	{
-		BlackHoleParameters params;
-		float time = 0;
-		bool hardCheck = false;
-		glm::ivec2 windowSize{ 0 };
+		BlackHoleParameters params; // Uniform buffer, only rewritten when the ui changed something
+		BlackHoleComputePush push;
 	};
 
 	struct BlackHoleFrameInfo {
@@ -115,7 +123,7 @@ namespace narwhal {
 		float frameTime;
 		VkCommandBuffer commandBuffer;
 		VkDescriptorSet computeDescriptorSet;
-		VkFence computeFence;
+		BlackHoleComputePush push;
 	};
 
 	struct QuadFrameInfo {
@@ -124,21 +132,34 @@ namespace narwhal {
 		VkDescriptorSet renderDescriptorSet;
 	};
 
+	// Has to fit the 128 bytes every device guarantees for push constants, so only one of the matrices goes in here
+	struct InitPush {
+		glm::ivec2 windowSize;
+		glm::ivec2 tileCount;
+		alignas(16) Matrix44 camToWorld;
+		//alignas(16) glm::mat4 camToWorld;
+		alignas(16) glm::vec3 camPosCartesian;
+		alignas(16) glm::vec3 camPosSpherical;
+	};
+	static_assert(sizeof(InitPush) <= 128, "init push constants over the guaranteed limit");
+
 	struct InitFrameInfo {
 		int frameIndex;
 		VkCommandBuffer commandBuffer;
 		VkDescriptorSet initDescriptorSet;
-		VkFence computeFence;
+		InitPush push;
 	};
 
+	struct PresentFrameInfo {
+		int frameIndex;
+		VkCommandBuffer commandBuffer;
+		VkDescriptorSet presentDescriptorSet;
+	};
+
+	// Only the projection and the horizon, the rest of the camera goes in as push constants
 	struct InitParameters {
-		glm::ivec2 windowSize;
-		alignas(16) Matrix44 camToWorld;
-		//alignas(16) glm::mat4 camToWorld;
 		alignas(16) Matrix44 camInverseProj;
 		//alignas(16) glm::mat4 camInverseProj;
-		alignas(16)glm::vec3 camPosCartesian;
-		alignas(16)glm::vec3 camPosSpherical;
 		float horizonRadius;
 	};
 }
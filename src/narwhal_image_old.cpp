@@ -13,7 +13,6 @@ namespace narwhal {
 		textureHeight{ 0 },textureWidth{ 0 },textureChannels{ 0 }, imageSize{0}
 	{
 		image = nullptr;
-		imageMemory = nullptr;
 		this->name = name;
 	}
 	NarwhalImageOld::~NarwhalImageOld()
@@ -21,7 +20,7 @@ namespace narwhal {
 		
 		vkDestroyImageView(narwhalDevice.device(), imageView, nullptr);
 		vkDestroyImage(narwhalDevice.device() ,image, nullptr);
-		vkFreeMemory(narwhalDevice.device(), imageMemory, nullptr);
+		narwhalDevice.getAllocator().free(imageAllocation);
 		
 		
 	}
@@ -126,7 +125,8 @@ namespace narwhal {
 			imageInfo,
 			properties,
 			image,
-			imageMemory
+			imageAllocation,
+			NarwhalMemoryCategory::Textures
 		);
 	}
 
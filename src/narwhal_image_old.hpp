@@ -48,7 +48,7 @@ namespace narwhal {
 		
 		VkImage image= nullptr;
 		VkImageView imageView = nullptr;
-		VkDeviceMemory imageMemory=nullptr;
+		NarwhalAllocation imageAllocation{};
 
 		
 	
@@ -30,61 +30,88 @@ namespace std {
 
 namespace narwhal {
 	NarwhalModel::NarwhalModel(NarwhalDevice& device, const NarwhalModel::Builder& builder) :narwhalDevice{ device } {
+		NarwhalUploadBatch uploadBatch{ narwhalDevice };
+		createTextures(uploadBatch, builder);
+		createBuffers(uploadBatch, builder);
+		uploadBatch.finish();
+		registerBuffers();
+	}
 
-		// Create Buffers
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
-		createMaterialColorBuffers(builder.materials);
-		createMaterialIndexBuffers(builder.materialIndices);
-		
-		// Create Textures
-		auto textureOffset = static_cast<uint32_t>(builder.textureNames.size());
-		for (auto name : builder.textureNames) {
-			std::string path = "data/textures/" + name;
-			NarwhalImage texture{ narwhalDevice, path };
-			textures.push_back(texture);
+	NarwhalModel::NarwhalModel(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, const NarwhalModel::Builder& builder) :narwhalDevice{ device } {
+		createTextures(uploadBatch, builder);
+		createBuffers(uploadBatch, builder);
+		registerBuffers();
+	}
+
+	NarwhalModel::~NarwhalModel() {
+		// In flight frames can still sample through the slots, so the textures and buffers go with them
+		NarwhalBindlessTable& bindlessTable = narwhalDevice.getBindlessTable();
+		for (size_t i = 0; i < textureIndices.size(); i++) {
+			bindlessTable.releaseTexture(textureIndices[i], std::move(textures[i]));
 		}
+		bindlessTable.releaseBuffer(materialColorBufferIndex, std::move(materialColorBuffer));
+		bindlessTable.releaseBuffer(materialIndexBufferIndex, std::move(materialIndexBuffer));
+	}
 
+	void NarwhalModel::createBuffers(NarwhalUploadBatch& uploadBatch, const NarwhalModel::Builder& builder)
+	{
+		createVertexBuffers(uploadBatch, builder.vertices);
+		createIndexBuffers(uploadBatch, builder.indices);
 
+		// Shaders index the global table, so the per model texture ids get swapped for the bindless slots
+		std::vector<MaterialObj> materials = builder.materials;
+		for (auto& material : materials) {
+			if (material.textureID < 0 || material.textureID >= static_cast<int>(textureIndices.size())) continue;
+			uint32_t index = textureIndices[material.textureID];
+			material.textureID = index == NarwhalBindlessTable::INVALID_INDEX ? -1 : static_cast<int>(index);
+		}
+		createMaterialColorBuffers(uploadBatch, materials);
+		createMaterialIndexBuffers(uploadBatch, builder.materialIndices);
+	}
+
+	void NarwhalModel::createTextures(NarwhalUploadBatch& uploadBatch, const NarwhalModel::Builder& builder)
+	{
+		NarwhalBindlessTable& bindlessTable = narwhalDevice.getBindlessTable();
+		for (const auto& name : builder.textureNames) {
+			std::string path = "data/textures/" + name;
+			textures.push_back(std::make_unique<NarwhalImage>(narwhalDevice, uploadBatch, path));
+
+			// Writing the descriptor before the batch flushed is fine, nothing samples it until then
+			textureIndices.push_back(bindlessTable.registerTexture(textures.back()->getDescriptorImageInfo()));
+		}
 	}
-	NarwhalModel::~NarwhalModel() {
 
+	void NarwhalModel::registerBuffers()
+	{
+		NarwhalBindlessTable& bindlessTable = narwhalDevice.getBindlessTable();
+		if (hasMaterialColorBuffer) materialColorBufferIndex = bindlessTable.registerBuffer(materialColorBuffer->descriptorInfo());
+		if (hasMaterialIndexBuffer) materialIndexBufferIndex = bindlessTable.registerBuffer(materialIndexBuffer->descriptorInfo());
 	}
 
 
-	void NarwhalModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+	void NarwhalModel::createVertexBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<Vertex>& vertices)
 	{
 		vertexCount = static_cast<uint32_t> (vertices.size());
 		assert(vertexCount >= 3 && "Vertex count must be at least 3!");
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
 		uint32_t vertexSize = sizeof(vertices[0]);
 
-		NarwhalBuffer stagingBuffer{
-			narwhalDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-
-		// Map the buffer memory and copy the data
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
-
 		vertexBuffer = std::make_unique<NarwhalBuffer>(
 			narwhalDevice,
 			vertexSize,
 			vertexCount,
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1,
+			NarwhalMemoryCategory::Meshes
 			);
 
-		// Copy from staging buffer to vertex buffer
-		narwhalDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+		// Staged and copied when the batch flushes
+		uploadBatch.uploadBuffer(vertices.data(), bufferSize, vertexBuffer->getBuffer());
 
 	}
 
-	void NarwhalModel::createIndexBuffers(const std::vector<uint32_t>& indices)
+	void NarwhalModel::createIndexBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<uint32_t>& indices)
 	{
 		indexCount = static_cast<uint32_t> (indices.size());
 		hasIndexBuffer = indexCount > 0;
@@ -95,96 +122,66 @@ namespace narwhal {
 		uint32_t indexSize = sizeof(indices[0]);
 
 
-		NarwhalBuffer stagingBuffer{
-			narwhalDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-
-		// Map the buffer memory and copy the data
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
-
 		indexBuffer = std::make_unique<NarwhalBuffer>(
 			narwhalDevice,
 			indexSize,
 			indexCount,
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1,
+			NarwhalMemoryCategory::Meshes
 			);
 
-		// Copy from staging buffer to vertex buffer
-		narwhalDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		// Staged and copied when the batch flushes
+		uploadBatch.uploadBuffer(indices.data(), bufferSize, indexBuffer->getBuffer());
 	}
 
-	void NarwhalModel::createMaterialColorBuffers(const std::vector<MaterialObj>& materials) {
+	void NarwhalModel::createMaterialColorBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<MaterialObj>& materials) {
 		materialColorCount = static_cast<uint32_t> (materials.size());
 		hasMaterialColorBuffer = materialColorCount > 0;
-		if (!hasIndexBuffer) return;
+		if (!hasMaterialColorBuffer) return;
 
 		VkDeviceSize bufferSize = sizeof(materials[0]) * materialColorCount;
 
 		uint32_t materialSize = sizeof(materials[0]);
 
 
-		NarwhalBuffer stagingBuffer{
-			narwhalDevice,
-			materialSize,
-			materialColorCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-
-		// Map the buffer memory and copy the data
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)materials.data());
-
 		materialColorBuffer = std::make_unique<NarwhalBuffer>(
 			narwhalDevice,
 			materialSize,
 			materialColorCount,
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1,
+			NarwhalMemoryCategory::Meshes
 			);
 
-		// Copy from staging buffer to materialColor buffer
-		narwhalDevice.copyBuffer(stagingBuffer.getBuffer(), materialColorBuffer->getBuffer(), bufferSize);
+		// Staged and copied when the batch flushes
+		uploadBatch.uploadBuffer(materials.data(), bufferSize, materialColorBuffer->getBuffer());
 	}
 
-	void NarwhalModel::createMaterialIndexBuffers(const std::vector<uint32_t>& materialIndexes) {
+	void NarwhalModel::createMaterialIndexBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<uint32_t>& materialIndexes) {
 		materialIndexCount = static_cast<uint32_t> (materialIndexes.size());
 		hasMaterialIndexBuffer = materialIndexCount > 0;
-		if (!hasIndexBuffer) return;
+		if (!hasMaterialIndexBuffer) return;
 
 		VkDeviceSize bufferSize = sizeof(materialIndexes[0]) * materialIndexCount;
 
 		uint32_t materialIndexSize = sizeof(materialIndexes[0]);
 
 
-		NarwhalBuffer stagingBuffer{
-			narwhalDevice,
-			materialIndexSize,
-			materialIndexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-
-		// Map the buffer memory and copy the data
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)materialIndexes.data());
-
 		materialIndexBuffer = std::make_unique<NarwhalBuffer>(
 			narwhalDevice,
 			materialIndexSize,
 			materialIndexCount,
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1,
+			NarwhalMemoryCategory::Meshes
 			);
 
-		// Copy from staging buffer to materialIndexBuffer buffer
-		narwhalDevice.copyBuffer(stagingBuffer.getBuffer(), materialIndexBuffer->getBuffer(), bufferSize);
+		// Staged and copied when the batch flushes
+		uploadBatch.uploadBuffer(materialIndexes.data(), bufferSize, materialIndexBuffer->getBuffer());
 	}
 
 	std::unique_ptr<NarwhalModel> NarwhalModel::createModelFromFile(NarwhalDevice& device, const std::string& filepath)
@@ -194,6 +191,13 @@ namespace narwhal {
 		return std::make_unique<NarwhalModel>(device, builder);
 	}
 
+	std::unique_ptr<NarwhalModel> NarwhalModel::createModelFromFile(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, const std::string& filepath)
+	{
+		Builder builder{};
+		builder.loadModel(filepath);
+		return std::make_unique<NarwhalModel>(device, uploadBatch, builder);
+	}
+
 	void NarwhalModel::bind(VkCommandBuffer commandBuffer)
 	{
 		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
@@ -3,6 +3,8 @@
 #include "narwhal_device.hpp"
 #include "narwhal_buffer.hpp"
 #include "narwhal_image.hpp"
+#include "narwhal_upload_batch.hpp"
+#include "narwhal_bindless_table.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -68,26 +70,38 @@ namespace narwhal {
 		};
 
 		NarwhalModel(NarwhalDevice& device, const NarwhalModel::Builder& builder);
+		// Geometry goes into the shared batch, dont draw before it is flushed
+		NarwhalModel(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, const NarwhalModel::Builder& builder);
 		~NarwhalModel();
 		
 		NarwhalModel(const NarwhalModel&) = delete;
 		NarwhalModel& operator=(const NarwhalModel&) = delete;
 
 		static std::unique_ptr<NarwhalModel> createModelFromFile(NarwhalDevice& device, const std::string& filepath);
+		static std::unique_ptr<NarwhalModel> createModelFromFile(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, const std::string& filepath);
 
 		void bind(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
 
+		// Slots in the device's bindless table, INVALID_INDEX when it was full. Material textureIDs already point into it
+		uint32_t getMaterialBufferIndex() const { return materialColorBufferIndex; }
+		uint32_t getMaterialIndexBufferIndex() const { return materialIndexBufferIndex; }
+
 		
 	private:
-		void createVertexBuffers(const std::vector<Vertex>& vertices);
-		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void createBuffers(NarwhalUploadBatch& uploadBatch, const NarwhalModel::Builder& builder);
+		void createTextures(NarwhalUploadBatch& uploadBatch, const NarwhalModel::Builder& builder);
+		void registerBuffers();
+
+		void createVertexBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<Vertex>& vertices);
+		void createIndexBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<uint32_t>& indices);
 
-		void createMaterialColorBuffers(const std::vector<MaterialObj>& materials);
+		void createMaterialColorBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<MaterialObj>& materials);
 
-		void createMaterialIndexBuffers(const std::vector<uint32_t>& materialIndexes);
+		void createMaterialIndexBuffers(NarwhalUploadBatch& uploadBatch, const std::vector<uint32_t>& materialIndexes);
 		
-		std::vector<NarwhalImage> textures{};
+		std::vector<std::unique_ptr<NarwhalImage>> textures{};
+		std::vector<uint32_t> textureIndices{}; // Bindless slot per texture
 		
 		NarwhalDevice& narwhalDevice;
 		
@@ -105,6 +119,9 @@ namespace narwhal {
 		bool hasMaterialIndexBuffer = false;
 		std::unique_ptr<NarwhalBuffer> materialIndexBuffer;
 		uint32_t materialIndexCount;
+
+		uint32_t materialColorBufferIndex = NarwhalBindlessTable::INVALID_INDEX;
+		uint32_t materialIndexBufferIndex = NarwhalBindlessTable::INVALID_INDEX;
 		
 		
 		
@@ -16,7 +16,6 @@ namespace narwhal {
 			const std::string& fragFilepath,
 			const PipelineConfigInfo& configInfo) : narwhalDevice(device)
 		{
-			createPipelineCache();
 			createGraphicsPipeline(vertFilepath, fragFilepath,configInfo);
 		}
 
@@ -26,7 +25,6 @@ namespace narwhal {
 			const std::string& compFilepath,
 			const PipelineConfigInfo& configInfo) : narwhalDevice(device)
 		{
-			createPipelineCache();
 			createGraphicsPipeline(vertFilepath, fragFilepath, compFilepath, configInfo);
 		}
 
@@ -34,7 +32,6 @@ namespace narwhal {
 			const std::string& compFilepath,
 			const PipelineConfigInfo& configInfo) : narwhalDevice(device)
 		{
-			createPipelineCache();
 			createComputePipeline(compFilepath, configInfo);
 		}
 		
@@ -49,14 +46,6 @@ namespace narwhal {
 		
 		}
 
-		void NarwhalPipeline::createPipelineCache() {
-			VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-			pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-			VK_CHECK(vkCreatePipelineCache(narwhalDevice.device(), &pipelineCacheCreateInfo, nullptr, &pipelineCache));
-		}
-		
-		
-
 		void NarwhalPipeline::addShaderStage(VkPipelineShaderStageCreateInfo shaderStage[], int pos, VkShaderStageFlagBits stage, VkShaderModule shaderModule, const char* entryPoint, VkSpecializationInfo* specializationInfo) {
 			shaderStage[pos].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			shaderStage[pos].stage = stage;
@@ -107,9 +96,10 @@ namespace narwhal {
 			info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 			info.stage.module = compShaderModule;
 			info.stage.pName = "main";
+			info.stage.pSpecializationInfo = configInfo.specializationInfo;
 			info.layout = configInfo.pipelineLayout;
 
-			if (vkCreateComputePipelines(narwhalDevice.device(), pipelineCache, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+			if (vkCreateComputePipelines(narwhalDevice.device(), narwhalDevice.getPipelineCache().getPipelineCache(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
 				throw std::runtime_error("Failed to create compute pipeline!");
 			}
 
@@ -170,7 +160,7 @@ namespace narwhal {
 			VkGraphicsPipelineCreateInfo pipelineInfo = makePipelineCreateInfo(2, shaderStages, vertexInputInfo, configInfo);
 			
 			
-			if (vkCreateGraphicsPipelines(narwhalDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			if (vkCreateGraphicsPipelines(narwhalDevice.device(), narwhalDevice.getPipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 				throw std::runtime_error("Failed to create graphics pipeline!");
 			}
 			
@@ -214,7 +204,7 @@ namespace narwhal {
 			VkGraphicsPipelineCreateInfo pipelineInfo = makePipelineCreateInfo(3, shaderStages, vertexInputInfo, configInfo);
 
 			
-			if (vkCreateGraphicsPipelines(narwhalDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			if (vkCreateGraphicsPipelines(narwhalDevice.device(), narwhalDevice.getPipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 				throw std::runtime_error("Failed to create graphics pipeline!");
 			}
 
@@ -354,4 +344,20 @@ namespace narwhal {
 			barrier.size = VK_WHOLE_SIZE;
 			vkCmdPipelineBarrier(cmd, srcStageMask, dstStageMask, false, 0, nullptr, 1, &barrier, 0, nullptr);
 		}
+		void imageOwnershipBarrier(VkCommandBuffer cmd, VkImage image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t srcQueueFamily, uint32_t dstQueueFamily, VkImageLayout layout)
+		{
+			bool transfer = srcQueueFamily != dstQueueFamily;
+			VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.oldLayout = layout;
+			barrier.newLayout = layout;
+			barrier.srcQueueFamilyIndex = transfer ? srcQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = transfer ? dstQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			vkCmdPipelineBarrier(cmd, srcStageMask, dstStageMask, false, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
 }
\ No newline at end of file
@@ -35,11 +35,14 @@ namespace narwhal {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		const VkSpecializationInfo* specializationInfo = nullptr; // Compute stage only for now
 	};
 	
 	void memoryBarrier(VkCommandBuffer cmd, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
 	void imageMemoryBarrier(VkCommandBuffer cmd, VkImage image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkImageLayout oldLayout, VkImageLayout newLayout );
 	void bufferMemoryBarrier(VkCommandBuffer cmd, VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+	// Release or acquire half of a queue family ownership transfer, a plain barrier when both families match
+	void imageOwnershipBarrier(VkCommandBuffer cmd, VkImage image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t srcQueueFamily, uint32_t dstQueueFamily, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
 	
 	class NarwhalPipeline
 	{
@@ -64,8 +67,6 @@ namespace narwhal {
 
 		~NarwhalPipeline();
 
-		void createPipelineCache();
-
 
 		NarwhalPipeline(const NarwhalPipeline&) = delete;
 		NarwhalPipeline& operator=(const NarwhalPipeline&) = delete;
@@ -100,7 +101,6 @@ namespace narwhal {
 		VkShaderModule vertShaderModule;
 		VkShaderModule fragShaderModule;
 		VkShaderModule compShaderModule;
-		VkPipelineCache pipelineCache;
 		
 		PipelineType pipelineType = PipelineType::UNKNOWN;
 	};
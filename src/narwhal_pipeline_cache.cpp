@@ -0,0 +1,104 @@
+#include "narwhal_pipeline_cache.hpp"
+
+#include "narwhal_device.hpp"
+
+//std
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+namespace narwhal {
+	NarwhalPipelineCache::NarwhalPipelineCache(NarwhalDevice& device, const std::string& path) : narwhalDevice{ device }, path{ path }
+	{
+		// A missing, stale or broken file just means a cold start
+		std::string data;
+		loaded = loadData(data);
+		loadedSize = loaded ? data.size() : 0;
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = loadedSize;
+		cacheInfo.pInitialData = loaded ? data.data() : nullptr;
+		if (vkCreatePipelineCache(narwhalDevice.device(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+
+	NarwhalPipelineCache::~NarwhalPipelineCache()
+	{
+		save();
+		vkDestroyPipelineCache(narwhalDevice.device(), pipelineCache, nullptr);
+	}
+
+	NarwhalPipelineCache::FileHeader NarwhalPipelineCache::makeHeader(uint64_t dataSize) const
+	{
+		const VkPhysicalDeviceProperties& properties = narwhalDevice.properties;
+		FileHeader header{};
+		header.magic = FILE_MAGIC;
+		header.headerVersion = FILE_VERSION;
+		header.vendorID = properties.vendorID;
+		header.deviceID = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = dataSize;
+		return header;
+	}
+
+	bool NarwhalPipelineCache::loadData(std::string& data)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) return false;
+
+		size_t fileSize = (size_t)file.tellg();
+		if (fileSize < sizeof(FileHeader)) return false;
+		file.seekg(0);
+
+		FileHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+		FileHeader expected = makeHeader(fileSize - sizeof(FileHeader));
+		if (!file || memcmp(&header, &expected, sizeof(FileHeader)) != 0) {
+			std::cout << "Pipeline cache " << path << " is from another device or driver, starting cold" << std::endl;
+			return false;
+		}
+
+		data.resize(static_cast<size_t>(header.dataSize));
+		file.read(data.data(), data.size());
+		if (!file) return false;
+
+		// Same checks again on the driver's own header, a truncated blob would otherwise be its problem
+		VkPipelineCacheHeaderVersionOne cacheHeader{};
+		if (data.size() < sizeof(cacheHeader)) return false;
+		memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+		return cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& cacheHeader.vendorID == expected.vendorID && cacheHeader.deviceID == expected.deviceID
+			&& memcmp(cacheHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	bool NarwhalPipelineCache::save()
+	{
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(narwhalDevice.device(), pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return false;
+		std::vector<char> data(dataSize);
+		if (vkGetPipelineCacheData(narwhalDevice.device(), pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return false;
+
+		// Written next to the old one and swapped in, a crash halfway never leaves a broken cache behind
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				std::cout << "Failed to write pipeline cache: " << tempPath << std::endl;
+				return false;
+			}
+			FileHeader header = makeHeader(dataSize);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+			file.write(data.data(), dataSize);
+			if (!file) return false;
+		}
+		std::remove(path.c_str());
+		return std::rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+}
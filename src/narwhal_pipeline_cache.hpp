@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+//std
+#include <cstdint>
+#include <string>
+
+
+namespace narwhal {
+	class NarwhalDevice;
+
+	// One VkPipelineCache shared by every pipeline on the device, loaded from disk at startup and written back
+	// on shutdown so the big update kernels only get compiled from scratch once per driver.
+	// Vulkan caches are internally synchronized, pipelines can be created from several threads with it
+	class NarwhalPipelineCache
+	{
+	public:
+		static constexpr const char* DEFAULT_PATH = "pipeline_cache.bin";
+
+		NarwhalPipelineCache(NarwhalDevice& device, const std::string& path = DEFAULT_PATH);
+		~NarwhalPipelineCache();
+
+		NarwhalPipelineCache(const NarwhalPipelineCache&) = delete;
+		NarwhalPipelineCache& operator=(const NarwhalPipelineCache&) = delete;
+
+		VkPipelineCache getPipelineCache() const { return pipelineCache; }
+		// Writes the current contents, also done by the destructor. Returns false if the file couldnt be written
+		bool save();
+
+		// Whether startup found a cache file this device and driver can use
+		bool wasLoaded() const { return loaded; }
+		size_t getLoadedSize() const { return loadedSize; }
+
+	private:
+		// Our own header in front of the driver's data. The driver checks its UUID header too but a cache from
+		// another driver version is better thrown away here than handed to it
+		struct FileHeader {
+			uint64_t dataSize;
+			uint32_t magic;
+			uint32_t headerVersion;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint32_t reserved; // No padding, the whole header gets compared with memcmp
+		};
+		static_assert(sizeof(FileHeader) == 48, "pipeline cache header has padding");
+
+		static constexpr uint32_t FILE_MAGIC = 0x4E575043; // "NWPC"
+		static constexpr uint32_t FILE_VERSION = 1;
+
+		FileHeader makeHeader(uint64_t dataSize) const;
+		bool loadData(std::string& data);
+
+		NarwhalDevice& narwhalDevice;
+		std::string path;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		bool loaded = false;
+		size_t loadedSize = 0;
+	};
+}
@@ -0,0 +1,97 @@
+#include "narwhal_pipeline_compiler.hpp"
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+
+namespace narwhal {
+	bool NarwhalPipelineHandle::isReady() const
+	{
+		return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	NarwhalPipeline* NarwhalPipelineHandle::get() const
+	{
+		if (!isReady()) return nullptr;
+		return future.get().get();
+	}
+
+	NarwhalPipeline& NarwhalPipelineHandle::wait() const
+	{
+		assert(future.valid() && "Cannot wait on a pipeline that was never requested!");
+		return *future.get();
+	}
+
+	void NarwhalPipelineHandle::join() const
+	{
+		if (future.valid()) future.wait();
+	}
+
+	NarwhalPipelineCompiler::NarwhalPipelineCompiler(uint32_t threadCount)
+	{
+		if (threadCount == 0) {
+			uint32_t cores = std::thread::hardware_concurrency();
+			threadCount = std::clamp(cores > 1 ? cores - 1 : 1u, 1u, MAX_THREADS);
+		}
+
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	NarwhalPipelineCompiler::~NarwhalPipelineCompiler()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+			queue.clear(); // Their handles report a broken promise, nothing waits on them at shutdown
+		}
+		condition.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	NarwhalPipelineHandle NarwhalPipelineCompiler::compile(CreateFunction create)
+	{
+		std::packaged_task<std::unique_ptr<NarwhalPipeline>()> task{ std::move(create) };
+		NarwhalPipelineHandle handle;
+		handle.future = task.get_future().share();
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			queue.push_back(std::move(task));
+		}
+		condition.notify_one();
+		return handle;
+	}
+
+	uint32_t NarwhalPipelineCompiler::getPendingCount()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return static_cast<uint32_t>(queue.size()) + buildingCount;
+	}
+
+	void NarwhalPipelineCompiler::workerLoop()
+	{
+		while (true) {
+			std::packaged_task<std::unique_ptr<NarwhalPipeline>()> task;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (stopping) return;
+				task = std::move(queue.front());
+				queue.pop_front();
+				buildingCount++;
+			}
+
+			// Exceptions end up in the future and get rethrown by whoever waits on the handle
+			task();
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			buildingCount--;
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "narwhal_pipeline.hpp"
+
+//std
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace narwhal {
+
+	// A pipeline that may still be compiling. Cheap to copy, every copy sees the same pipeline
+	class NarwhalPipelineHandle
+	{
+	public:
+		NarwhalPipelineHandle() = default;
+
+		// Whether it was ever requested
+		bool isValid() const { return future.valid(); }
+		// Finished compiling, successfully or not
+		bool isReady() const;
+		// Null while it's still compiling. Rethrows whatever the build threw
+		NarwhalPipeline* get() const;
+		// Blocks until it's done
+		NarwhalPipeline& wait() const;
+		// Blocks without rethrowing, for destructors that free something the build still uses
+		void join() const;
+
+	private:
+		friend class NarwhalPipelineCompiler;
+		std::shared_future<std::unique_ptr<NarwhalPipeline>> future;
+	};
+
+	// Worker threads that build pipelines off the render thread. Systems queue their pipelines from the constructor
+	// and only wait when they first record with them, so everything compiles in parallel instead of one after another.
+	// Builds go through the device's pipeline cache, which vulkan lets several threads use at once
+	class NarwhalPipelineCompiler
+	{
+	public:
+		// Builds the pipeline on a worker. Anything the config points into has to live inside the function
+		using CreateFunction = std::function<std::unique_ptr<NarwhalPipeline>()>;
+
+		static constexpr uint32_t MAX_THREADS = 4;
+
+		// 0 picks from the core count, leaving one for the render thread
+		NarwhalPipelineCompiler(uint32_t threadCount = 0);
+		// Joins the workers, builds still queued are dropped
+		~NarwhalPipelineCompiler();
+
+		NarwhalPipelineCompiler(const NarwhalPipelineCompiler&) = delete;
+		NarwhalPipelineCompiler& operator=(const NarwhalPipelineCompiler&) = delete;
+
+		NarwhalPipelineHandle compile(CreateFunction create);
+
+		// Queued plus currently building
+		uint32_t getPendingCount();
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::deque<std::packaged_task<std::unique_ptr<NarwhalPipeline>()>> queue;
+		uint32_t buildingCount = 0;
+		bool stopping = false;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+}
@@ -0,0 +1,106 @@
+#include "narwhal_readback.hpp"
+
+#include "narwhal_pipeline.hpp"
+
+
+namespace narwhal {
+	NarwhalReadback::NarwhalReadback(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+		slots.resize(MAX_SLOTS);
+	}
+
+	NarwhalReadback::~NarwhalReadback()
+	{
+		// Copies still in flight keep their staging ranges until they finished, recorded ones never get submitted
+		NarwhalStagingPool& stagingPool = narwhalDevice.getStagingPool();
+		for (Slot& slot : slots) {
+			stagingPool.release(slot.staging, slot.state == SlotState::Submitted ? slot.submission : NarwhalSubmission{});
+		}
+	}
+
+	NarwhalReadback::Slot* NarwhalReadback::acquireSlot(VkDeviceSize size)
+	{
+		for (Slot& slot : slots) {
+			if (slot.state != SlotState::Free) continue;
+
+			// 16 covers every texel size, image copies need their buffer offset to be a multiple of it
+			slot.staging = narwhalDevice.getStagingPool().allocate(size, 16, NarwhalStagingUsage::Readback);
+			slot.state = SlotState::Recorded;
+			slot.size = size;
+			return &slot;
+		}
+		return nullptr;
+	}
+
+	bool NarwhalReadback::readBuffer(VkCommandBuffer commandBuffer, NarwhalQueueType queueType, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, Callback callback, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+	{
+		Slot* slot = acquireSlot(size);
+		if (slot == nullptr) return false;
+		slot->queueType = queueType;
+		slot->callback = std::move(callback);
+
+		bufferMemoryBarrier(commandBuffer, buffer, srcAccess, VK_ACCESS_TRANSFER_READ_BIT, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = offset;
+		copyRegion.dstOffset = slot->staging.offset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, buffer, slot->staging.buffer, 1, &copyRegion);
+
+		bufferMemoryBarrier(commandBuffer, slot->staging.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		return true;
+	}
+
+	bool NarwhalReadback::readImage(VkCommandBuffer commandBuffer, NarwhalQueueType queueType, VkImage image, VkImageLayout layout, uint32_t width, uint32_t height, uint32_t texelSize, Callback callback, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+	{
+		Slot* slot = acquireSlot(static_cast<VkDeviceSize>(width) * height * texelSize);
+		if (slot == nullptr) return false;
+		slot->queueType = queueType;
+		slot->callback = std::move(callback);
+
+		imageMemoryBarrier(commandBuffer, image, srcAccess, VK_ACCESS_TRANSFER_READ_BIT, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT, layout, layout);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = slot->staging.offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { width, height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, image, layout, slot->staging.buffer, 1, &region);
+
+		bufferMemoryBarrier(commandBuffer, slot->staging.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+		return true;
+	}
+
+	void NarwhalReadback::submitted(NarwhalQueueType queueType, const NarwhalSubmission& submission)
+	{
+		for (Slot& slot : slots) {
+			if (slot.state == SlotState::Recorded && slot.queueType == queueType) {
+				slot.state = SlotState::Submitted;
+				slot.submission = submission;
+			}
+		}
+	}
+
+	void NarwhalReadback::update()
+	{
+		for (Slot& slot : slots) {
+			if (slot.state != SlotState::Submitted || !slot.submission.isComplete()) continue;
+
+			NarwhalStagingPool& stagingPool = narwhalDevice.getStagingPool();
+			stagingPool.invalidate(slot.staging);
+			slot.callback(slot.staging.mapped, slot.size);
+			slot.callback = nullptr;
+			stagingPool.release(slot.staging);
+			slot.state = SlotState::Free;
+		}
+	}
+
+	uint32_t NarwhalReadback::getPendingCount() const
+	{
+		uint32_t count = 0;
+		for (const Slot& slot : slots) {
+			if (slot.state != SlotState::Free) count++;
+		}
+		return count;
+	}
+}
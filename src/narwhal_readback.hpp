@@ -0,0 +1,60 @@
+#pragma once
+
+#include "narwhal_device.hpp"
+
+//std
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace narwhal {
+
+	// Gpu to cpu copies without stalling. A copy is recorded into a command buffer the caller submits anyway,
+	// lands in a range of the device's staging pool and is handed to the callback once that submit finished,
+	// usually a frame or two later. If every slot is still in flight the request is dropped
+	class NarwhalReadback
+	{
+	public:
+		using Callback = std::function<void(const void* data, VkDeviceSize size)>;
+
+		static constexpr uint32_t MAX_SLOTS = 8;
+
+		NarwhalReadback(NarwhalDevice& device);
+		~NarwhalReadback();
+
+		NarwhalReadback(const NarwhalReadback&) = delete;
+		NarwhalReadback& operator=(const NarwhalReadback&) = delete;
+
+		// src stage and access describe the last gpu write to the source, returns false if the request was dropped
+		bool readBuffer(VkCommandBuffer commandBuffer, NarwhalQueueType queueType, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, Callback callback,
+			VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags srcAccess = VK_ACCESS_SHADER_WRITE_BIT);
+		// Tightly packed texels, the image needs TRANSFER_SRC usage and has to stay in layout during the copy
+		bool readImage(VkCommandBuffer commandBuffer, NarwhalQueueType queueType, VkImage image, VkImageLayout layout, uint32_t width, uint32_t height, uint32_t texelSize, Callback callback,
+			VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags srcAccess = VK_ACCESS_SHADER_WRITE_BIT);
+
+		// Tags every copy recorded for this queue since the last call with the submit that carries it
+		void submitted(NarwhalQueueType queueType, const NarwhalSubmission& submission);
+		// Runs the callbacks of every finished copy, call once per frame
+		void update();
+
+		uint32_t getPendingCount() const;
+
+	private:
+		enum class SlotState { Free, Recorded, Submitted };
+
+		struct Slot {
+			NarwhalStagingAllocation staging{};
+			SlotState state = SlotState::Free;
+			NarwhalQueueType queueType;
+			NarwhalSubmission submission{};
+			VkDeviceSize size = 0;
+			Callback callback;
+		};
+
+		Slot* acquireSlot(VkDeviceSize size);
+
+		NarwhalDevice& narwhalDevice;
+		std::vector<Slot> slots;
+	};
+}
@@ -22,8 +22,6 @@ namespace narwhal {
 			extent = narwhalWindow.getExtent();
 			glfwWaitEvents();
 		}
-		vkDeviceWaitIdle(narwhalDevice.device()); //Wait until current swapchain stops being used
-
 		if (narwhalSwapChain == nullptr) {
 			narwhalSwapChain = std::make_unique<NarwhalSwapChain>(narwhalDevice, extent);
 		}
@@ -35,6 +33,9 @@ namespace narwhal {
 				throw std::runtime_error("Swapchain image format or color space has changed!");
 			}
 
+			// Frames in flight may still render to or present from the old chain, it goes once they finished
+			narwhalDevice.getDeletionQueue().retire([oldSwapChain]() {});
+
 			
 			
 		}
@@ -67,7 +68,8 @@ namespace narwhal {
 	}
 	VkCommandBuffer NarwhalRenderer::beginFrame() {
 		assert(!isFrameStarted && "Cant call beginFrame while frame already in progress");
-		
+		narwhalDevice.getDeletionQueue().collect();
+		narwhalDevice.getStagingPool().collect();
 		
 		auto result = narwhalSwapChain->acquireNextImage(&currentImageIndex);
 
@@ -102,7 +104,9 @@ namespace narwhal {
 			throw std::runtime_error("failed to record command buffer!");
 		}
 
-		auto result = narwhalSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		auto result = narwhalSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, frameSync);
+		frameSync = {};
+		lastSubmission = narwhalSwapChain->getLastSubmission();
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || narwhalWindow.wasWindowResized()) {
 			narwhalWindow.resetWindowResizedFlag();
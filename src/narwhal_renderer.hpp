@@ -46,6 +46,11 @@ namespace narwhal {
 		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// Consumed by the next endFrame submit
+		void addWait(const NarwhalSubmission& submission, VkPipelineStageFlags stage) { frameSync.wait(submission, stage); }
+		// Graphics timeline point of the last ended frame, other queues wait on it to take resources back
+		NarwhalSubmission getLastSubmission() const { return lastSubmission; }
+
 	private:
 		void createCommandBuffers();
 		void freeCommandBuffers();
@@ -56,6 +61,8 @@ namespace narwhal {
 		NarwhalDevice& narwhalDevice;
 		std::unique_ptr<NarwhalSwapChain> narwhalSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
+		NarwhalSubmitSync frameSync{};
+		NarwhalSubmission lastSubmission{};
 		
 		uint32_t currentImageIndex;
 		int currentFrameIndex{0};
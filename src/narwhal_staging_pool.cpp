@@ -0,0 +1,199 @@
+#include "narwhal_staging_pool.hpp"
+
+#include "narwhal_device.hpp"
+#include "narwhal_buffer.hpp"
+
+//std
+#include <algorithm>
+
+
+namespace narwhal {
+	struct NarwhalStagingChunk {
+		std::unique_ptr<NarwhalBuffer> buffer;
+		NarwhalStagingUsage usage;
+		VkDeviceSize offset = 0; // Bump pointer
+		uint32_t liveCount = 0; // Ranges handed out and not released yet
+		std::vector<NarwhalSubmission> pending; // Latest submit per timeline that used a released range
+	};
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	NarwhalStagingPool::NarwhalStagingPool(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+		memoryProperties[static_cast<size_t>(NarwhalStagingUsage::Upload)] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		VkMemoryPropertyFlags readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(narwhalDevice.getPhysicalDevice(), &deviceMemoryProperties);
+		for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
+			VkMemoryPropertyFlags flags = deviceMemoryProperties.memoryTypes[i].propertyFlags;
+			if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+				readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+				break;
+			}
+		}
+		memoryProperties[static_cast<size_t>(NarwhalStagingUsage::Readback)] = readbackProperties;
+	}
+
+	NarwhalStagingPool::~NarwhalStagingPool()
+	{
+		// Dont free memory the gpu is still copying from or into
+		for (auto& usageChunks : chunks) {
+			for (auto& chunk : usageChunks) {
+				for (const NarwhalSubmission& submission : chunk->pending) submission.wait();
+			}
+		}
+	}
+
+	NarwhalStagingAllocation NarwhalStagingPool::allocate(VkDeviceSize size, VkDeviceSize alignment, NarwhalStagingUsage usage)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		size_t usageIndex = static_cast<size_t>(usage);
+
+		NarwhalStagingChunk* chunk = findChunk(size, alignment, usage);
+		if (chunk == nullptr) {
+			if (size > CHUNK_SIZE) chunk = createChunk(size, usage);
+			else if (chunks[usageIndex].size() < MAX_CHUNKS) chunk = createChunk(CHUNK_SIZE, usage);
+			else chunk = waitForChunk(size, usage);
+		}
+		// Every chunk still has live ranges, nothing to wait on so the footprint has to grow
+		if (chunk == nullptr) chunk = createChunk(CHUNK_SIZE, usage);
+
+		NarwhalStagingAllocation allocation{};
+		allocation.buffer = chunk->buffer->getBuffer();
+		allocation.offset = alignUp(chunk->offset, alignment);
+		allocation.size = size;
+		allocation.mapped = static_cast<char*>(chunk->buffer->getMappedMemory()) + allocation.offset;
+		allocation.chunk = chunk;
+
+		chunk->offset = allocation.offset + size;
+		chunk->liveCount++;
+		peaks[usageIndex] = std::max(peaks[usageIndex], getReserved(usageIndex));
+		return allocation;
+	}
+
+	void NarwhalStagingPool::release(NarwhalStagingAllocation& allocation, const NarwhalSubmission& submission)
+	{
+		if (!allocation.isValid()) return;
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		NarwhalStagingChunk& chunk = *allocation.chunk;
+		chunk.liveCount--;
+
+		if (!submission.isEmpty() && !submission.isComplete()) {
+			// Values on a timeline only grow, the latest one covers the earlier submits
+			auto it = std::find_if(chunk.pending.begin(), chunk.pending.end(),
+				[&submission](const NarwhalSubmission& other) { return other.getTimeline() == submission.getTimeline(); });
+			if (it == chunk.pending.end()) chunk.pending.push_back(submission);
+			else if (it->getValue() < submission.getValue()) *it = submission;
+		}
+		allocation = {};
+	}
+
+	void NarwhalStagingPool::invalidate(const NarwhalStagingAllocation& allocation)
+	{
+		if ((memoryProperties[static_cast<size_t>(allocation.chunk->usage)] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) return;
+		allocation.chunk->buffer->invalidate(allocation.size, allocation.offset);
+	}
+
+	void NarwhalStagingPool::collect()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (size_t usageIndex = 0; usageIndex < USAGE_COUNT; usageIndex++) {
+			auto& usageChunks = chunks[usageIndex];
+			VkDeviceSize keep = std::max(peaks[usageIndex], previousPeaks[usageIndex]);
+
+			VkDeviceSize capacity = 0;
+			for (auto& chunk : usageChunks) capacity += chunk->buffer->getBufferSize();
+
+			// Oversized chunks go first, they're the ones that dont fit the steady state
+			std::stable_sort(usageChunks.begin(), usageChunks.end(),
+				[](const auto& a, const auto& b) { return a->buffer->getBufferSize() > b->buffer->getBufferSize(); });
+			for (auto it = usageChunks.begin(); it != usageChunks.end();) {
+				VkDeviceSize chunkSize = (*it)->buffer->getBufferSize();
+				if (tryReset(**it) && capacity - chunkSize >= keep) {
+					capacity -= chunkSize;
+					it = usageChunks.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+
+			previousPeaks[usageIndex] = peaks[usageIndex];
+			peaks[usageIndex] = getReserved(usageIndex);
+		}
+	}
+
+	NarwhalStagingStats NarwhalStagingPool::getStats(NarwhalStagingUsage usage)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		size_t usageIndex = static_cast<size_t>(usage);
+
+		NarwhalStagingStats stats{};
+		for (auto& chunk : chunks[usageIndex]) {
+			stats.chunkCount++;
+			stats.capacity += chunk->buffer->getBufferSize();
+		}
+		stats.reserved = getReserved(usageIndex);
+		stats.peak = std::max(peaks[usageIndex], previousPeaks[usageIndex]);
+		return stats;
+	}
+
+	NarwhalStagingChunk* NarwhalStagingPool::findChunk(VkDeviceSize size, VkDeviceSize alignment, NarwhalStagingUsage usage)
+	{
+		for (auto& chunk : chunks[static_cast<size_t>(usage)]) {
+			tryReset(*chunk);
+			if (alignUp(chunk->offset, alignment) + size <= chunk->buffer->getBufferSize()) return chunk.get();
+		}
+		return nullptr;
+	}
+
+	NarwhalStagingChunk* NarwhalStagingPool::createChunk(VkDeviceSize size, NarwhalStagingUsage usage)
+	{
+		auto chunk = std::make_unique<NarwhalStagingChunk>();
+		VkBufferUsageFlags bufferUsage = usage == NarwhalStagingUsage::Upload ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT : VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		chunk->buffer = std::make_unique<NarwhalBuffer>(narwhalDevice, size, 1, bufferUsage, memoryProperties[static_cast<size_t>(usage)], 1, NarwhalMemoryCategory::Staging);
+		chunk->buffer->map();
+		chunk->usage = usage;
+
+		auto& usageChunks = chunks[static_cast<size_t>(usage)];
+		usageChunks.push_back(std::move(chunk));
+		return usageChunks.back().get();
+	}
+
+	NarwhalStagingChunk* NarwhalStagingPool::waitForChunk(VkDeviceSize size, NarwhalStagingUsage usage)
+	{
+		// Holds the pool lock while waiting, every other staging request would have to wait for the same gpu work anyway
+		for (auto& chunk : chunks[static_cast<size_t>(usage)]) {
+			if (chunk->liveCount > 0 || chunk->buffer->getBufferSize() < size) continue;
+
+			for (const NarwhalSubmission& submission : chunk->pending) submission.wait();
+			tryReset(*chunk);
+			return chunk.get();
+		}
+		return nullptr;
+	}
+
+	bool NarwhalStagingPool::tryReset(NarwhalStagingChunk& chunk)
+	{
+		if (chunk.liveCount > 0) return false;
+
+		chunk.pending.erase(std::remove_if(chunk.pending.begin(), chunk.pending.end(),
+			[](const NarwhalSubmission& submission) { return submission.isComplete(); }), chunk.pending.end());
+		if (!chunk.pending.empty()) return false;
+
+		chunk.offset = 0;
+		return true;
+	}
+
+	VkDeviceSize NarwhalStagingPool::getReserved(size_t usageIndex) const
+	{
+		VkDeviceSize reserved = 0;
+		for (const auto& chunk : chunks[usageIndex]) reserved += chunk->offset;
+		return reserved;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "narwhal_timeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+//std
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace narwhal {
+	class NarwhalDevice;
+	class NarwhalBuffer;
+	struct NarwhalStagingChunk;
+
+	enum class NarwhalStagingUsage {
+		Upload, // Write combined, the cpu only ever writes it
+		Readback, // Host cached when the device has it, cpu reads from uncached memory are slow
+	};
+
+	// A range of a pooled staging buffer. Stays valid until it's released back to the pool
+	struct NarwhalStagingAllocation {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr; // Already offset to this range
+		NarwhalStagingChunk* chunk = nullptr;
+
+		bool isValid() const { return chunk != nullptr; }
+	};
+
+	struct NarwhalStagingStats {
+		uint32_t chunkCount = 0;
+		VkDeviceSize capacity = 0;
+		VkDeviceSize reserved = 0; // Handed out or still waiting on the gpu
+		VkDeviceSize peak = 0; // Most reserved at once over the last two collects, idle chunks past it get freed
+	};
+
+	// Staging memory shared by every upload and readback. Ranges are bump allocated out of a few big
+	// persistently mapped buffers, a buffer starts over once everything in it was released and the
+	// submits using it finished. Past MAX_CHUNKS new requests wait for the gpu to free a chunk up instead
+	// of growing, so big loads stream through a fixed footprint
+	class NarwhalStagingPool
+	{
+	public:
+		static constexpr VkDeviceSize CHUNK_SIZE = 16 * 1024 * 1024; // Bigger requests get a chunk of their own
+		static constexpr uint32_t MAX_CHUNKS = 4; // Per usage
+
+		NarwhalStagingPool(NarwhalDevice& device);
+		~NarwhalStagingPool();
+
+		NarwhalStagingPool(const NarwhalStagingPool&) = delete;
+		NarwhalStagingPool& operator=(const NarwhalStagingPool&) = delete;
+
+		NarwhalStagingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment, NarwhalStagingUsage usage = NarwhalStagingUsage::Upload);
+		// The range can be reused once the submission finished, an empty one frees it right away
+		void release(NarwhalStagingAllocation& allocation, const NarwhalSubmission& submission = {});
+		// Readback ranges have to be invalidated before the cpu reads them on non coherent memory
+		void invalidate(const NarwhalStagingAllocation& allocation);
+
+		// Frees idle chunks the last two collects didnt need, cheap enough to call every frame
+		void collect();
+		NarwhalStagingStats getStats(NarwhalStagingUsage usage);
+
+	private:
+		static constexpr size_t USAGE_COUNT = 2;
+
+		NarwhalStagingChunk* findChunk(VkDeviceSize size, VkDeviceSize alignment, NarwhalStagingUsage usage);
+		NarwhalStagingChunk* createChunk(VkDeviceSize size, NarwhalStagingUsage usage);
+		NarwhalStagingChunk* waitForChunk(VkDeviceSize size, NarwhalStagingUsage usage);
+		bool tryReset(NarwhalStagingChunk& chunk);
+		VkDeviceSize getReserved(size_t usageIndex) const;
+
+		NarwhalDevice& narwhalDevice;
+		std::array<VkMemoryPropertyFlags, USAGE_COUNT> memoryProperties;
+		std::array<std::vector<std::unique_ptr<NarwhalStagingChunk>>, USAGE_COUNT> chunks;
+		std::array<VkDeviceSize, USAGE_COUNT> peaks{}; // Since the last collect
+		std::array<VkDeviceSize, USAGE_COUNT> previousPeaks{};
+		std::mutex mutex;
+	};
+}
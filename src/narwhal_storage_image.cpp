@@ -1,4 +1,5 @@
 #include "narwhal_storage_image.hpp"
+#include "narwhal_pipeline.hpp"
 
 
 namespace narwhal {
@@ -8,11 +9,43 @@ namespace narwhal {
 		createImageView();
 
 	}
+	NarwhalStorageImage::NarwhalStorageImage(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, uint32_t width, uint32_t height, VkFormat imageFormat, std::string name) :narwhalDevice(device), name(name), width(width), height(height), imageFormat(imageFormat)
+	{
+		createStorageImage(uploadBatch, width, height);
+		createImageView();
+	}
+	NarwhalStorageImage::NarwhalStorageImage(NarwhalDevice& device, NarwhalQueueType queueType, uint32_t width, uint32_t height, VkFormat imageFormat, std::string name) :narwhalDevice(device), name(name), width(width), height(height), imageFormat(imageFormat), queueType(queueType)
+	{
+		createStorageImage(width, height);
+		createImageView();
+	}
 	NarwhalStorageImage::~NarwhalStorageImage()
 	{
 		destroy();
 	}
 	void NarwhalStorageImage::createStorageImage(uint32_t width, uint32_t height)
+	{
+		if (queueType == NarwhalQueueType::Graphics) {
+			NarwhalUploadBatch uploadBatch{ narwhalDevice };
+			createStorageImage(uploadBatch, width, height);
+			uploadBatch.finish();
+			return;
+		}
+
+		// The first use of the image is on this queue, so that queue family owns it from here on
+		allocateImage(width, height);
+		VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands(queueType);
+		imageMemoryBarrier(commandBuffer, image, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		narwhalDevice.endSingleTimeCommands(commandBuffer, queueType);
+	}
+	void NarwhalStorageImage::createStorageImage(NarwhalUploadBatch& uploadBatch, uint32_t width, uint32_t height)
+	{
+		allocateImage(width, height);
+
+		//We then transition the image to the VK_IMAGE_LAYOUT_GENERAL
+		uploadBatch.transitionImage(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	}
+	void NarwhalStorageImage::allocateImage(uint32_t width, uint32_t height)
 	{
 		// Create the image
 		VkImageCreateInfo imageCreateInfo{};
@@ -26,40 +59,15 @@ namespace narwhal {
 		imageCreateInfo.arrayLayers = 1;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT; // TODO: Maybe remove sampled bit?
+		imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // TODO: Maybe remove sampled bit?
 		imageCreateInfo.initialLayout= VK_IMAGE_LAYOUT_UNDEFINED;
 
 		if (vkCreateImage(narwhalDevice.device(), &imageCreateInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create storage image with name" + name); 
 		}
 
-		// Get the memory requirements for the image
-		VkMemoryRequirements memoryRequirements;
-		vkGetImageMemoryRequirements(narwhalDevice.device(), image, &memoryRequirements);
-
-		// Allocate the memory for the image
-
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = narwhalDevice.findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		if (vkAllocateMemory(narwhalDevice.device(), &memoryAllocateInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate storage image memory with name" + name);
-		}
-
-		// We now prepare the image for copying by transitioning it to the VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL layout.
-		//narwhalDevice.transitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-		// Bind the memory to the image
-		if (vkBindImageMemory(narwhalDevice.device(), image, imageMemory, 0) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to bind storage image memory with name" + name);
-		}
-
-		//We then transition the image to the VK_IMAGE_LAYOUT_GENERAL
-		narwhalDevice.transitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-
-
+		// Full screen float targets are big enough to end up with a dedicated allocation
+		imageAllocation = narwhalDevice.getAllocator().allocateImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, NarwhalMemoryCategory::RayState); // Storage images only hold trace state
 	}
 	void NarwhalStorageImage::createImageView()
 	{
@@ -84,7 +92,17 @@ namespace narwhal {
 			return;
 		}
 
-		destroy();
+		// Frames in flight can still be tracing into the old image
+		VkDevice device = narwhalDevice.device();
+		VkImage oldImage = image;
+		VkImageView oldImageView = imageView;
+		NarwhalAllocation oldImageAllocation = imageAllocation;
+		NarwhalAllocator* allocator = &narwhalDevice.getAllocator();
+		narwhalDevice.getDeletionQueue().retire([device, oldImage, oldImageView, oldImageAllocation, allocator]() mutable {
+			vkDestroyImageView(device, oldImageView, nullptr);
+			vkDestroyImage(device, oldImage, nullptr);
+			allocator->free(oldImageAllocation);
+		});
 
 		this->width = width;
 		this->height = height;
@@ -105,6 +123,6 @@ namespace narwhal {
 	{
 		vkDestroyImageView(narwhalDevice.device(), imageView, nullptr);
 		vkDestroyImage(narwhalDevice.device(), image, nullptr);
-		vkFreeMemory(narwhalDevice.device(), imageMemory, nullptr);
+		narwhalDevice.getAllocator().free(imageAllocation);
 	}
 }
\ No newline at end of file
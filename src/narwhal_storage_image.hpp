@@ -1,6 +1,7 @@
 #pragma once
 #include "narwhal_device.hpp"
 #include "narwhal_buffer.hpp"
+#include "narwhal_upload_batch.hpp"
 
 #include <vulkan/vulkan.hpp>
 
@@ -13,18 +14,24 @@ namespace narwhal {
 	{
 		public:
 		NarwhalStorageImage(NarwhalDevice& device, uint32_t width, uint32_t height, VkFormat imageFormat= VK_FORMAT_R32G32B32A32_SFLOAT, std::string name="STORAGE_IMAGE");
+		// The initial GENERAL transition goes into the shared batch
+		NarwhalStorageImage(NarwhalDevice& device, NarwhalUploadBatch& uploadBatch, uint32_t width, uint32_t height, VkFormat imageFormat = VK_FORMAT_R32G32B32A32_SFLOAT, std::string name = "STORAGE_IMAGE");
+		// Transitioned on the queue that uses it, also on resize, so an image only compute touches never needs an ownership transfer
+		NarwhalStorageImage(NarwhalDevice& device, NarwhalQueueType queueType, uint32_t width, uint32_t height, VkFormat imageFormat = VK_FORMAT_R32G32B32A32_SFLOAT, std::string name = "STORAGE_IMAGE");
 		~NarwhalStorageImage();
 
 		void createStorageImage(uint32_t width, uint32_t height);
+		void createStorageImage(NarwhalUploadBatch& uploadBatch, uint32_t width, uint32_t height);
 		void createImageView();
 
 		VkImageView getImageView() { return imageView; };
 		VkImage getImage() { return image; };
-		VkDeviceMemory getImageMemory() { return imageMemory; };
+		const NarwhalAllocation& getAllocation() { return imageAllocation; };
 
 		uint32_t getWidth() { return width; };
 		uint32_t getHeight() { return height; };
 
+		// The old image is retired through the device's deletion queue, only waits on the new image's layout transition
 		void resize(uint32_t width, uint32_t height);
 
 		VkDescriptorImageInfo getDescriptorImageInfo();
@@ -34,6 +41,7 @@ namespace narwhal {
 
 		private:
 
+			void allocateImage(uint32_t width, uint32_t height);
 			void destroy();
 
 			NarwhalDevice& narwhalDevice;
@@ -42,10 +50,11 @@ namespace narwhal {
 			uint32_t width, height;
 
 			VkFormat imageFormat;
+			NarwhalQueueType queueType = NarwhalQueueType::Graphics;
 
 			VkImage image = nullptr;
 			VkImageView imageView = nullptr;
-			VkDeviceMemory imageMemory = nullptr;
+			NarwhalAllocation imageAllocation{};
 	};
 }
 
@@ -8,6 +8,7 @@
 #include <limits>
 #include <set>
 #include <stdexcept>
+#include <mutex>
 
 namespace narwhal {
 
@@ -19,6 +20,9 @@ namespace narwhal {
 	NarwhalSwapChain::NarwhalSwapChain(NarwhalDevice& deviceRef, VkExtent2D extent, std::shared_ptr<NarwhalSwapChain> previous)
 		: device{ deviceRef }, windowExtent{ extent }, oldSwapChain{ previous } {
 		init();
+		// Nothing idled the device, so the renderer's command buffers are still guarded by the old chain's submits
+		inFlightSubmissions = previous->inFlightSubmissions;
+		currentFrame = previous->currentFrame;
 
 		
 		//clean up old swap chain since its no longer needed
@@ -48,7 +52,7 @@ namespace narwhal {
 		for (int i = 0; i < depthImages.size(); i++) {
 			vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
 			vkDestroyImage(device.device(), depthImages[i], nullptr);
-			vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+			device.getAllocator().free(depthImageMemorys[i]);
 		}
 
 		for (auto framebuffer : swapChainFramebuffers) {
@@ -61,17 +65,11 @@ namespace narwhal {
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device.device(), inFlightFences[i], nullptr);
 		}
 	}
 
 	VkResult NarwhalSwapChain::acquireNextImage(uint32_t* imageIndex) {
-		vkWaitForFences(
-			device.device(),
-			1,
-			&inFlightFences[currentFrame],
-			VK_TRUE,
-			std::numeric_limits<uint64_t>::max());
+		inFlightSubmissions[currentFrame].wait();
 
 		VkResult result = vkAcquireNextImageKHR(
 			device.device(),
@@ -84,34 +82,17 @@ namespace narwhal {
 		return result;
 	}
 
-	VkResult NarwhalSwapChain::submitCommandBuffers(
-		const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-		if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-		}
-		imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
-
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
-
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = buffers;
+	VkResult NarwhalSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, NarwhalSubmitSync extraSync) {
+		imagesInFlight[*imageIndex].wait();
 
+		// Present only waits on renderFinished, the extra signals go to the other queues
+		extraSync.wait(imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		extraSync.signal(renderFinishedSemaphores[currentFrame]);
 		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-		if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-			VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
-		}
+		lastSubmission = device.submit(NarwhalQueueType::Graphics, 1, buffers, extraSync);
+		inFlightSubmissions[currentFrame] = lastSubmission;
+		imagesInFlight[*imageIndex] = lastSubmission;
 
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -125,7 +106,11 @@ namespace narwhal {
 
 		presentInfo.pImageIndices = imageIndex;
 
-		auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+		VkResult result;
+		{
+			std::lock_guard<std::mutex> lock{ device.getQueueMutex() }; // The present queue can be the graphics queue
+			result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+		}
 
 		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -217,6 +202,14 @@ namespace narwhal {
 	}
 
 	void NarwhalSwapChain::createRenderPass() {
+		// Pipelines are compiled against the render pass on worker threads, so it has to outlive a resize
+		if (oldSwapChain != nullptr && oldSwapChain->swapChainImageFormat == swapChainImageFormat &&
+			oldSwapChain->swapChainDepthFormat == findDepthFormat()) {
+			renderPass = oldSwapChain->renderPass;
+			oldSwapChain->renderPass = VK_NULL_HANDLE;
+			return;
+		}
+
 		VkAttachmentDescription depthAttachment{};
 		depthAttachment.format = findDepthFormat();
 		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -332,7 +325,8 @@ namespace narwhal {
 				imageInfo,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				depthImages[i],
-				depthImageMemorys[i]);
+				depthImageMemorys[i],
+				NarwhalMemoryCategory::SwapChain);
 
 			VkImageViewCreateInfo viewInfo{};
 			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -354,22 +348,17 @@ namespace narwhal {
 	void NarwhalSwapChain::createSyncObjects() {
 		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+		inFlightSubmissions.resize(MAX_FRAMES_IN_FLIGHT);
+		imagesInFlight.resize(imageCount());
 
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo = {};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
 				VK_SUCCESS ||
 				vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-				VK_SUCCESS ||
-				vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+				VK_SUCCESS) {
 				throw std::runtime_error("failed to create synchronization objects for a frame!");
 			}
 		}
@@ -38,7 +38,10 @@ namespace narwhal {
 		VkFormat findDepthFormat();
 
 		VkResult acquireNextImage(uint32_t* imageIndex);
-		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		// The extra sync lets other queues hand resources to and from this frame's submit
+		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, NarwhalSubmitSync extraSync = {});
+		// Graphics timeline point of the last submitted frame
+		NarwhalSubmission getLastSubmission() const { return lastSubmission; }
 
 		bool compareSwapFormats(const NarwhalSwapChain& other) const {
 			return	swapChainImageFormat == other.swapChainImageFormat &&
@@ -69,7 +72,7 @@ namespace narwhal {
 		VkRenderPass renderPass;
 
 		std::vector<VkImage> depthImages;
-		std::vector<VkDeviceMemory> depthImageMemorys;
+		std::vector<NarwhalAllocation> depthImageMemorys;
 		std::vector<VkImageView> depthImageViews;
 		std::vector<VkImage> swapChainImages;
 		std::vector<VkImageView> swapChainImageViews;
@@ -82,8 +85,9 @@ namespace narwhal {
 
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
-		std::vector<VkFence> imagesInFlight;
+		std::vector<NarwhalSubmission> inFlightSubmissions;
+		std::vector<NarwhalSubmission> imagesInFlight;
+		NarwhalSubmission lastSubmission{};
 		size_t currentFrame = 0;
 	};
 
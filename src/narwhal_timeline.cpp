@@ -0,0 +1,125 @@
+#include "narwhal_timeline.hpp"
+
+#include "narwhal_device.hpp"
+
+//std
+#include <stdexcept>
+
+
+namespace narwhal {
+
+	bool NarwhalSubmission::isComplete() const
+	{
+		return timeline == nullptr || timeline->isComplete(value);
+	}
+
+	void NarwhalSubmission::wait() const
+	{
+		if (timeline != nullptr) timeline->wait(value);
+	}
+
+	NarwhalTimeline::NarwhalTimeline(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		if (vkCreateSemaphore(narwhalDevice.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create timeline semaphore!");
+		}
+	}
+
+	NarwhalTimeline::~NarwhalTimeline()
+	{
+		waitIdle();
+		vkDestroySemaphore(narwhalDevice.device(), semaphore, nullptr);
+	}
+
+	uint64_t NarwhalTimeline::getCompletedValue()
+	{
+		uint64_t value = 0;
+		if (vkGetSemaphoreCounterValue(narwhalDevice.device(), semaphore, &value) != VK_SUCCESS) {
+			throw std::runtime_error("failed to read timeline semaphore!");
+		}
+		updateCompleted(value);
+		return value;
+	}
+
+	bool NarwhalTimeline::isComplete(uint64_t value)
+	{
+		if (value <= completedValue) return true;
+		return value <= getCompletedValue();
+	}
+
+	void NarwhalTimeline::wait(uint64_t value)
+	{
+		if (isComplete(value)) return;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+
+		if (vkWaitSemaphores(narwhalDevice.device(), &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("failed to wait on timeline semaphore!");
+		}
+		updateCompleted(value);
+	}
+
+	void NarwhalTimeline::updateCompleted(uint64_t value)
+	{
+		// Another thread may already have cached a later value
+		uint64_t cached = completedValue;
+		while (cached < value && !completedValue.compare_exchange_weak(cached, value)) {}
+	}
+
+	void NarwhalSubmitSync::wait(VkSemaphore binarySemaphore, VkPipelineStageFlags stage)
+	{
+		waitSemaphores.push_back(binarySemaphore);
+		waitValues.push_back(0);
+		waitStages.push_back(stage);
+	}
+
+	void NarwhalSubmitSync::wait(const NarwhalSubmission& submission, VkPipelineStageFlags stage)
+	{
+		if (submission.isEmpty()) return;
+		waitSemaphores.push_back(submission.getTimeline()->getSemaphore());
+		waitValues.push_back(submission.getValue());
+		waitStages.push_back(stage);
+	}
+
+	void NarwhalSubmitSync::signal(VkSemaphore binarySemaphore)
+	{
+		signalSemaphores.push_back(binarySemaphore);
+		signalValues.push_back(0);
+	}
+
+	void NarwhalSubmitSync::signal(NarwhalTimeline& timeline, uint64_t value)
+	{
+		signalSemaphores.push_back(timeline.getSemaphore());
+		signalValues.push_back(value);
+	}
+
+	void NarwhalSubmitSync::apply(VkSubmitInfo& submitInfo, VkTimelineSemaphoreSubmitInfo& timelineInfo) const
+	{
+		timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+	}
+}
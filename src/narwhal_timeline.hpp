@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+//std
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+
+namespace narwhal {
+	class NarwhalDevice;
+	class NarwhalTimeline;
+
+	// A point on a queue timeline: "everything submitted up to here finished". Cheap to copy and valid
+	// from any thread. An empty submission counts as complete
+	class NarwhalSubmission
+	{
+	public:
+		NarwhalSubmission() = default;
+		NarwhalSubmission(NarwhalTimeline* timeline, uint64_t value) : timeline{ timeline }, value{ value } {}
+
+		bool isComplete() const;
+		void wait() const;
+		bool isEmpty() const { return timeline == nullptr; }
+
+		NarwhalTimeline* getTimeline() const { return timeline; }
+		uint64_t getValue() const { return value; }
+
+	private:
+		NarwhalTimeline* timeline = nullptr;
+		uint64_t value = 0;
+	};
+
+	// Timeline semaphore of one queue. Every submit to the queue signals the next value, so a single
+	// counter answers "has submit N finished" for the cpu and for other queues
+	class NarwhalTimeline
+	{
+	public:
+		NarwhalTimeline(NarwhalDevice& device);
+		~NarwhalTimeline();
+
+		NarwhalTimeline(const NarwhalTimeline&) = delete;
+		NarwhalTimeline& operator=(const NarwhalTimeline&) = delete;
+
+		VkSemaphore getSemaphore() const { return semaphore; }
+
+		// Only call with the queue mutex held and submit straight after, values have to reach the queue in order
+		uint64_t nextValue() { return ++lastValue; }
+		uint64_t getLastValue() const { return lastValue; }
+
+		uint64_t getCompletedValue();
+		bool isComplete(uint64_t value);
+		void wait(uint64_t value);
+		// Everything submitted so far
+		void waitIdle() { wait(lastValue); }
+
+	private:
+		void updateCompleted(uint64_t value);
+
+		NarwhalDevice& narwhalDevice;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+
+		std::atomic<uint64_t> lastValue{ 0 };
+		std::atomic<uint64_t> completedValue{ 0 }; // Cached so polling a finished value doesnt hit the driver
+	};
+
+	// Semaphores for one vkQueueSubmit. Binary semaphores and timeline values can be mixed,
+	// the sync has to stay alive until the submit call returns
+	class NarwhalSubmitSync
+	{
+	public:
+		void wait(VkSemaphore binarySemaphore, VkPipelineStageFlags stage);
+		void wait(const NarwhalSubmission& submission, VkPipelineStageFlags stage); // Empty submissions are skipped
+		void signal(VkSemaphore binarySemaphore);
+		void signal(NarwhalTimeline& timeline, uint64_t value);
+
+		// Points submitInfo at the semaphores, chains timelineInfo into its pNext
+		void apply(VkSubmitInfo& submitInfo, VkTimelineSemaphoreSubmitInfo& timelineInfo) const;
+
+	private:
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<uint64_t> waitValues; // 0 for binary semaphores, ignored by the driver
+		std::vector<VkPipelineStageFlags> waitStages;
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+	};
+}
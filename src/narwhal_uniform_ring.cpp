@@ -0,0 +1,36 @@
+#include "narwhal_uniform_ring.hpp"
+
+//std
+#include <cstring>
+#include <stdexcept>
+
+
+namespace narwhal {
+	NarwhalUniformRing::NarwhalUniformRing(NarwhalDevice& device, VkDeviceSize frameSize, uint32_t frameCount) : frameCount{ frameCount }
+	{
+		alignment = device.getLimits().minUniformBufferOffsetAlignment;
+		// Frame regions start aligned so every offset handed out is a valid dynamic offset
+		this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+		buffer = std::make_unique<NarwhalBuffer>(device, this->frameSize, frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1, NarwhalMemoryCategory::Uniforms);
+		buffer->map();
+	}
+
+	void NarwhalUniformRing::beginFrame(int frameIndex)
+	{
+		frameStart = this->frameSize * (frameIndex % frameCount);
+		offset = frameStart;
+	}
+
+	uint32_t NarwhalUniformRing::push(const void* data, VkDeviceSize size)
+	{
+		if (offset + size > frameStart + frameSize) {
+			throw std::runtime_error("uniform ring frame region is full!");
+		}
+
+		uint32_t dynamicOffset = static_cast<uint32_t>(offset);
+		memcpy(static_cast<char*>(buffer->getMappedMemory()) + offset, data, static_cast<size_t>(size));
+		offset = (offset + size + alignment - 1) / alignment * alignment;
+		return dynamicOffset;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "narwhal_device.hpp"
+#include "narwhal_buffer.hpp"
+
+//std
+#include <memory>
+
+
+namespace narwhal {
+
+	// One persistently mapped uniform buffer for per frame data. Every frame in flight owns a region of it,
+	// uploads are bump allocated inside the region and bound through UNIFORM_BUFFER_DYNAMIC offsets,
+	// so the descriptor sets are written once and nothing is allocated or rewritten per frame
+	class NarwhalUniformRing
+	{
+	public:
+		NarwhalUniformRing(NarwhalDevice& device, VkDeviceSize frameSize, uint32_t frameCount);
+
+		NarwhalUniformRing(const NarwhalUniformRing&) = delete;
+		NarwhalUniformRing& operator=(const NarwhalUniformRing&) = delete;
+
+		// The caller makes sure the gpu is done with this frame's previous uploads, e.g. after beginFrame
+		void beginFrame(int frameIndex);
+		// Returns the dynamic offset to bind the data with
+		uint32_t push(const void* data, VkDeviceSize size);
+		template<typename T>
+		uint32_t push(const T& data) { return push(&data, sizeof(T)); }
+
+		// For the dynamic binding, range is the size of the struct the shader reads
+		VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) { return buffer->descriptorInfo(range, 0); }
+		VkDeviceSize getFrameSize() const { return frameSize; }
+		VkDeviceSize getFrameUsed() const { return offset - frameStart; }
+
+	private:
+		std::unique_ptr<NarwhalBuffer> buffer;
+		VkDeviceSize alignment;
+		VkDeviceSize frameSize;
+		uint32_t frameCount;
+		VkDeviceSize frameStart = 0;
+		VkDeviceSize offset = 0;
+	};
+}
@@ -0,0 +1,289 @@
+#include "narwhal_upload_batch.hpp"
+
+#include "narwhal_pipeline.hpp"
+
+//std
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+
+namespace narwhal {
+	NarwhalUploadBatch::NarwhalUploadBatch(NarwhalDevice& device) : narwhalDevice{ device }
+	{
+		// 16 covers every texel size we upload, image copies need their offset to be a multiple of it
+		alignment = std::max<VkDeviceSize>(16, narwhalDevice.getLimits().optimalBufferCopyOffsetAlignment);
+
+		transferFamily = narwhalDevice.getTransferQueueFamily();
+		graphicsFamily = narwhalDevice.getGraphicsQueueFamily();
+		dedicatedTransfer = transferFamily != graphicsFamily;
+	}
+
+	NarwhalUploadBatch::~NarwhalUploadBatch()
+	{
+		// Can run while unwinding from another throw, a second one would terminate
+		try {
+			finish();
+		}
+		catch (const std::exception& e) {
+			std::cerr << "upload batch failed to finish: " << e.what() << std::endl;
+		}
+	}
+
+	void NarwhalUploadBatch::finish()
+	{
+		if (!flushed) flush();
+		submission.wait();
+	}
+
+	NarwhalUploadBatch::StagingAllocation NarwhalUploadBatch::stage(const void* data, VkDeviceSize size)
+	{
+		if (flushed) {
+			throw std::runtime_error("cant upload through a batch that was already flushed!");
+		}
+
+		NarwhalStagingAllocation staging = narwhalDevice.getStagingPool().allocate(size, alignment);
+		memcpy(staging.mapped, data, static_cast<size_t>(size));
+		stagingAllocations.push_back(staging);
+		stagingSize += size;
+		uploadCount++;
+
+		return StagingAllocation{ staging.buffer, staging.offset };
+	}
+
+	VkCommandBuffer NarwhalUploadBatch::getTransferCommandBuffer()
+	{
+		if (transferCommandBuffer == VK_NULL_HANDLE) {
+			transferCommandBuffer = narwhalDevice.beginSingleTimeCommands(dedicatedTransfer ? NarwhalQueueType::Transfer : NarwhalQueueType::Graphics);
+			if (!dedicatedTransfer) graphicsCommandBuffer = transferCommandBuffer;
+		}
+		return transferCommandBuffer;
+	}
+
+	VkCommandBuffer NarwhalUploadBatch::getGraphicsCommandBuffer()
+	{
+		if (!dedicatedTransfer) return getTransferCommandBuffer();
+		if (graphicsCommandBuffer == VK_NULL_HANDLE) {
+			graphicsCommandBuffer = narwhalDevice.beginSingleTimeCommands(NarwhalQueueType::Graphics);
+		}
+		return graphicsCommandBuffer;
+	}
+
+	void NarwhalUploadBatch::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+	{
+		StagingAllocation staging = stage(data, size);
+		VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, staging.buffer, dstBuffer, 1, &copyRegion);
+
+		if (!dedicatedTransfer) return; // One memory barrier at flush covers every buffer
+
+		// Release on the transfer queue, acquire on graphics
+		VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	void NarwhalUploadBatch::uploadImage(const void* data, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height, uint32_t baseLayer, uint32_t layerCount, VkImageLayout finalLayout)
+	{
+		StagingAllocation staging = stage(data, size);
+		VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+
+		VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = baseLayer;
+		barrier.subresourceRange.layerCount = layerCount;
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = staging.offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = baseLayer;
+		region.imageSubresource.layerCount = layerCount;
+		region.imageExtent = { width, height, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		// Mip 0 of a mipmapped image is read by the blits, anything else by the shaders
+		bool mipSource = finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		VkAccessFlags dstAccess = mipSource ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+		VkPipelineStageFlags dstStage = mipSource ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		// The layout change rides on the release/acquire pair when the copy ran on the transfer queue
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		if (!dedicatedTransfer) {
+			barrier.dstAccessMask = dstAccess;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			return;
+		}
+
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void NarwhalUploadBatch::generateMipmaps(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount, VkImageLayout finalLayout)
+	{
+		if (flushed) {
+			throw std::runtime_error("cant upload through a batch that was already flushed!");
+		}
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(narwhalDevice.getPhysicalDevice(), format, &formatProperties);
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+			throw std::runtime_error("image format does not support linear blitting!");
+		}
+
+		// Blits need a graphics queue, mip 0 got there through the acquire in uploadImage
+		VkCommandBuffer commandBuffer = getGraphicsCommandBuffer();
+
+		VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layerCount;
+
+		int32_t mipWidth = static_cast<int32_t>(width);
+		int32_t mipHeight = static_cast<int32_t>(height);
+		for (uint32_t level = 1; level < mipLevels; level++) {
+			int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+			int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+			barrier.subresourceRange.baseMipLevel = level;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			VkImageBlit blit{};
+			blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = level - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = layerCount;
+			blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.dstSubresource.mipLevel = level;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = layerCount;
+			vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			// Source of the next level down
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		uploadCount++;
+	}
+
+	void NarwhalUploadBatch::transitionImage(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount)
+	{
+		if (flushed) {
+			throw std::runtime_error("cant upload through a batch that was already flushed!");
+		}
+
+		// No data involved, so it goes straight on the queue that will use the image
+		VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = layerCount;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		uploadCount++;
+	}
+
+	NarwhalSubmission NarwhalUploadBatch::flush()
+	{
+		if (flushed) {
+			throw std::runtime_error("upload batch was already flushed!");
+		}
+		flushed = true;
+
+		if (!dedicatedTransfer) {
+			if (transferCommandBuffer != VK_NULL_HANDLE) {
+				memoryBarrier(transferCommandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+				submission = narwhalDevice.submitSingleTimeCommands(transferCommandBuffer, NarwhalQueueType::Graphics);
+			}
+			releaseStaging();
+			return submission;
+		}
+
+		// The graphics acquires wait on the copies through the transfer timeline, so their value covers both submits
+		NarwhalSubmission transferSubmission{};
+		if (transferCommandBuffer != VK_NULL_HANDLE) {
+			transferSubmission = narwhalDevice.getCommandRing(NarwhalQueueType::Transfer).submit(transferCommandBuffer);
+			submission = transferSubmission;
+		}
+		if (graphicsCommandBuffer != VK_NULL_HANDLE) {
+			submission = narwhalDevice.getCommandRing(NarwhalQueueType::Graphics).submit(graphicsCommandBuffer, transferSubmission, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		}
+		releaseStaging();
+		return submission;
+	}
+
+	void NarwhalUploadBatch::releaseStaging()
+	{
+		// The copies only read staging on the transfer queue, but the graphics submit waits on it so its value covers them
+		NarwhalStagingPool& stagingPool = narwhalDevice.getStagingPool();
+		for (NarwhalStagingAllocation& staging : stagingAllocations) {
+			stagingPool.release(staging, submission);
+		}
+		stagingAllocations.clear();
+	}
+}
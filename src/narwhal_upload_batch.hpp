@@ -0,0 +1,76 @@
+#pragma once
+
+#include "narwhal_device.hpp"
+#include "narwhal_buffer.hpp"
+
+//std
+#include <memory>
+#include <vector>
+
+
+namespace narwhal {
+
+	// Collects a whole load phase worth of uploads and submits it once. Staging data comes out of the
+	// device's staging pool and the copies run on the transfer queue when the device has one, with the
+	// ownership acquires for the graphics queue chained behind it.
+	// Everything uploaded through a batch is only usable once flush has completed
+	class NarwhalUploadBatch
+	{
+	public:
+		NarwhalUploadBatch(NarwhalDevice& device);
+		~NarwhalUploadBatch();
+
+		NarwhalUploadBatch(const NarwhalUploadBatch&) = delete;
+		NarwhalUploadBatch& operator=(const NarwhalUploadBatch&) = delete;
+
+		void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+		// Fills the given layers from tightly packed texels and leaves them in finalLayout.
+		// TRANSFER_SRC_OPTIMAL leaves mip 0 ready for generateMipmaps
+		void uploadImage(const void* data, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height,
+			uint32_t baseLayer = 0, uint32_t layerCount = 1, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// Blits the rest of the chain down from mip 0 on the graphics queue, the image needs TRANSFER_SRC usage and
+		// a format that can be linearly filtered. Every mip ends up in finalLayout
+		void generateMipmaps(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels,
+			uint32_t layerCount = 1, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// Layout change without data, e.g. storage images going to GENERAL
+		void transitionImage(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount = 1);
+
+		// Single submit for everything recorded so far, can only be called once
+		NarwhalSubmission flush();
+		// Flushes if needed and waits for the copies, the staging ranges go back to the pool at flush
+		void finish();
+		bool isFlushed() const { return flushed; }
+
+		uint32_t getUploadCount() const { return uploadCount; }
+		VkDeviceSize getStagingSize() const { return stagingSize; }
+
+	private:
+		struct StagingAllocation {
+			VkBuffer buffer;
+			VkDeviceSize offset;
+		};
+
+		StagingAllocation stage(const void* data, VkDeviceSize size);
+		void releaseStaging();
+		VkCommandBuffer getTransferCommandBuffer();
+		VkCommandBuffer getGraphicsCommandBuffer();
+
+		NarwhalDevice& narwhalDevice;
+		VkDeviceSize alignment;
+
+		bool dedicatedTransfer;
+		uint32_t transferFamily;
+		uint32_t graphicsFamily;
+
+		std::vector<NarwhalStagingAllocation> stagingAllocations; // Released with the submit at flush
+
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE; // Same as the transfer one without a dedicated transfer queue
+
+		bool flushed = false;
+		NarwhalSubmission submission{}; // The graphics submit when there is one, it waits on the transfer submit
+
+		uint32_t uploadCount = 0;
+		VkDeviceSize stagingSize = 0;
+	};
+}
@@ -30,12 +30,28 @@ namespace narwhal {
 		window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
 		glfwSetWindowUserPointer(window, this); //Gets the pointer to the window
 		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback); //When window resized, call framebufferResizeCallback
+
+		// These only flag that something happened, imgui chains them when it installs its own callbacks
+		glfwSetKeyCallback(window, [](GLFWwindow* window, int, int, int, int) { markActivity(window); });
+		glfwSetCharCallback(window, [](GLFWwindow* window, unsigned int) { markActivity(window); });
+		glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int, int, int) { markActivity(window); });
+		glfwSetCursorPosCallback(window, [](GLFWwindow* window, double, double) { markActivity(window); });
+		glfwSetScrollCallback(window, [](GLFWwindow* window, double, double) { markActivity(window); });
+		glfwSetWindowFocusCallback(window, [](GLFWwindow* window, int) { markActivity(window); });
+		glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) { markActivity(window); });
+	}
+
+	void NarwhalWindow::markActivity(GLFWwindow* window)
+	{
+		auto narwhalWindow = reinterpret_cast<NarwhalWindow*>(glfwGetWindowUserPointer(window));
+		narwhalWindow->hadActivity = true;
 	}
 
 	void NarwhalWindow::framebufferResizeCallback(GLFWwindow* window, int width, int height)
 	{
 		auto narwhalWindow= reinterpret_cast<NarwhalWindow*>(glfwGetWindowUserPointer(window));
 		narwhalWindow->framebufferResized = true;
+		narwhalWindow->hadActivity = true;
 		narwhalWindow->width = width;
 		narwhalWindow->height = height;
 	}
@@ -19,17 +19,23 @@ namespace narwhal {
 		bool wasWindowResized() { return framebufferResized; }
 		void resetWindowResizedFlag() { framebufferResized = false; }
 		GLFWwindow* getGLFWwindow() const { return window; }
+		// Blocks until an event arrives or the timeout runs out
+		void waitEvents(double timeout) { glfwWaitEventsTimeout(timeout); }
+		// True if there was input, a resize or an expose since the last call
+		bool consumeActivity() { bool activity = hadActivity; hadActivity = false; return activity; }
 		
 		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 	private:
 		
 		static void framebufferResizeCallback(GLFWwindow* window, int width, int height); 
+		static void markActivity(GLFWwindow* window);
 		
 		void initWindow();
 		
 		int width;
 		int height;
 		bool framebufferResized = false;
+		bool hadActivity = true; // The first frame always draws
 		
 
 		std::string windowName;
@@ -0,0 +1,154 @@
+#include "narwhal_workgroup_tuner.hpp"
+
+//std
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+
+namespace narwhal {
+	NarwhalWorkgroupSpecialization::NarwhalWorkgroupSpecialization(NarwhalWorkgroupShape shape)
+	{
+		data = { static_cast<int32_t>(shape.x), static_cast<int32_t>(shape.y) };
+		for (uint32_t i = 0; i < 2; i++) {
+			entries[i].constantID = i;
+			entries[i].offset = i * sizeof(int32_t);
+			entries[i].size = sizeof(int32_t);
+		}
+		info.mapEntryCount = static_cast<uint32_t>(entries.size());
+		info.pMapEntries = entries.data();
+		info.dataSize = sizeof(data);
+		info.pData = data.data();
+	}
+
+	bool NarwhalWorkgroupTuner::isSpecializable(const std::string& spirvPath)
+	{
+		std::ifstream file{ spirvPath, std::ios::ate | std::ios::binary };
+		if (!file.is_open()) return false;
+
+		size_t wordCount = static_cast<size_t>(file.tellg()) / sizeof(uint32_t);
+		std::vector<uint32_t> words(wordCount);
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(words.data()), wordCount * sizeof(uint32_t));
+
+		constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+		constexpr uint32_t OP_DECORATE = 71;
+		constexpr uint32_t DECORATION_SPEC_ID = 1;
+		constexpr size_t HEADER_WORDS = 5;
+		if (wordCount < HEADER_WORDS || words[0] != SPIRV_MAGIC) return false;
+
+		// Walk the instructions looking for OpDecorate <id> SpecId 0 and 1
+		bool specX = false;
+		bool specY = false;
+		for (size_t i = HEADER_WORDS; i < wordCount;) {
+			uint32_t opcode = words[i] & 0xFFFF;
+			uint32_t length = words[i] >> 16;
+			if (length == 0 || i + length > wordCount) break;
+			if (opcode == OP_DECORATE && length >= 4 && words[i + 2] == DECORATION_SPEC_ID) {
+				specX |= words[i + 3] == 0;
+				specY |= words[i + 3] == 1;
+			}
+			i += length;
+		}
+		return specX && specY;
+	}
+
+	NarwhalWorkgroupTuner::NarwhalWorkgroupTuner(NarwhalDevice& device, const std::string& path) : narwhalDevice{ device }, path{ path }
+	{
+		VkPhysicalDeviceLimits limits = narwhalDevice.getLimits();
+		for (const NarwhalWorkgroupShape& shape : CANDIDATES) {
+			if (shape.x > limits.maxComputeWorkGroupSize[0] || shape.y > limits.maxComputeWorkGroupSize[1]) continue;
+			if (shape.invocations() > limits.maxComputeWorkGroupInvocations) continue;
+			candidates.push_back(shape);
+		}
+		load();
+	}
+
+	bool NarwhalWorkgroupTuner::isThisDevice(const Entry& entry) const
+	{
+		const VkPhysicalDeviceProperties& properties = narwhalDevice.properties;
+		return entry.vendorID == properties.vendorID && entry.deviceID == properties.deviceID && entry.driverVersion == properties.driverVersion;
+	}
+
+	NarwhalWorkgroupShape NarwhalWorkgroupTuner::getShape(const std::string& kernel) const
+	{
+		for (const Entry& entry : entries) {
+			if (entry.kernel == kernel && isThisDevice(entry)) return entry.shape;
+		}
+		return NarwhalWorkgroupShape{};
+	}
+
+	bool NarwhalWorkgroupTuner::isTuned(const std::string& kernel) const
+	{
+		return std::any_of(entries.begin(), entries.end(), [&](const Entry& entry) { return entry.kernel == kernel && isThisDevice(entry); });
+	}
+
+	void NarwhalWorkgroupTuner::startTuning(const std::string& kernel)
+	{
+		tuningKernel = kernel;
+		tuningCandidate = 0;
+		tuningSamples = 0;
+		bestTimes.assign(candidates.size(), std::numeric_limits<float>::max());
+	}
+
+	float NarwhalWorkgroupTuner::getTuningProgress() const
+	{
+		if (!isTuning()) return 1.f;
+		uint32_t total = static_cast<uint32_t>(candidates.size()) * SAMPLES_PER_CANDIDATE;
+		return static_cast<float>(tuningCandidate * SAMPLES_PER_CANDIDATE + tuningSamples) / total;
+	}
+
+	void NarwhalWorkgroupTuner::addSample(const std::string& kernel, NarwhalWorkgroupShape shape, float time)
+	{
+		// Samples from dispatches recorded before a switch still come in for a frame or two
+		if (!isTuning() || kernel != tuningKernel || shape != candidates[tuningCandidate] || time <= 0.f) return;
+
+		bestTimes[tuningCandidate] = std::min(bestTimes[tuningCandidate], time);
+		if (++tuningSamples < SAMPLES_PER_CANDIDATE) return;
+
+		tuningSamples = 0;
+		if (++tuningCandidate < candidates.size()) return;
+
+		size_t best = std::min_element(bestTimes.begin(), bestTimes.end()) - bestTimes.begin();
+		NarwhalWorkgroupShape bestShape = candidates[best];
+		std::cout << "Tuned " << kernel << " to " << bestShape.x << "x" << bestShape.y << std::endl;
+
+		entries.erase(std::remove_if(entries.begin(), entries.end(),
+			[&](const Entry& entry) { return entry.kernel == kernel && isThisDevice(entry); }), entries.end());
+		const VkPhysicalDeviceProperties& properties = narwhalDevice.properties;
+		entries.push_back(Entry{ properties.vendorID, properties.deviceID, properties.driverVersion, kernel, bestShape });
+		tuningKernel.clear();
+		save();
+	}
+
+	void NarwhalWorkgroupTuner::load()
+	{
+		// One "vendor device driver kernel x y" per line
+		std::ifstream file(path);
+		if (!file.is_open()) return;
+
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream stream(line);
+			Entry entry{};
+			if (!(stream >> entry.vendorID >> entry.deviceID >> entry.driverVersion >> entry.kernel >> entry.shape.x >> entry.shape.y)) continue;
+			// A shape this device cant run means the file got edited or the limits changed, ignore it
+			if (isThisDevice(entry) && std::find(candidates.begin(), candidates.end(), entry.shape) == candidates.end()) continue;
+			entries.push_back(entry);
+		}
+	}
+
+	void NarwhalWorkgroupTuner::save() const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) {
+			std::cout << "Failed to write workgroup sizes: " << path << std::endl;
+			return;
+		}
+		for (const Entry& entry : entries) {
+			file << entry.vendorID << " " << entry.deviceID << " " << entry.driverVersion << " " << entry.kernel << " " << entry.shape.x << " " << entry.shape.y << "\n";
+		}
+	}
+}
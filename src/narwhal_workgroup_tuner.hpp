@@ -0,0 +1,94 @@
+#pragma once
+
+#include "narwhal_device.hpp"
+
+//std
+#include <array>
+#include <string>
+#include <vector>
+
+
+namespace narwhal {
+
+	// Local size of the 2d compute kernels, fed in through specialization constants 0 and 1
+	struct NarwhalWorkgroupShape {
+		uint32_t x = 8;
+		uint32_t y = 8;
+
+		uint32_t invocations() const { return x * y; }
+		// Groups needed to cover a size
+		uint32_t groupsX(uint32_t width) const { return (width + x - 1) / x; }
+		uint32_t groupsY(uint32_t height) const { return (height + y - 1) / y; }
+		bool operator==(const NarwhalWorkgroupShape& other) const { return x == other.x && y == other.y; }
+		bool operator!=(const NarwhalWorkgroupShape& other) const { return !(*this == other); }
+	};
+
+	// Owns the map entries and data a VkSpecializationInfo points to, keep it alive until the pipeline is built
+	struct NarwhalWorkgroupSpecialization {
+		NarwhalWorkgroupSpecialization(NarwhalWorkgroupShape shape);
+
+		NarwhalWorkgroupSpecialization(const NarwhalWorkgroupSpecialization&) = delete;
+		NarwhalWorkgroupSpecialization& operator=(const NarwhalWorkgroupSpecialization&) = delete;
+
+		std::array<VkSpecializationMapEntry, 2> entries{};
+		std::array<int32_t, 2> data{};
+		VkSpecializationInfo info{};
+	};
+
+	// Picks the fastest work group shape per kernel on this device and remembers it between runs.
+	// Whoever dispatches the kernel runs the candidates in turn while tuning and reports the gpu time of each,
+	// normalized to the amount of work so dispatches of different sizes compare
+	class NarwhalWorkgroupTuner
+	{
+	public:
+		static constexpr const char* DEFAULT_PATH = "workgroup_sizes.txt";
+		static constexpr uint32_t SAMPLES_PER_CANDIDATE = 4; // Best of, the first dispatches after a switch are noisy
+		static constexpr std::array<NarwhalWorkgroupShape, 5> CANDIDATES = { { {8, 8}, {16, 8}, {32, 4}, {16, 16}, {64, 1} } };
+
+		NarwhalWorkgroupTuner(NarwhalDevice& device, const std::string& path = DEFAULT_PATH);
+
+		NarwhalWorkgroupTuner(const NarwhalWorkgroupTuner&) = delete;
+		NarwhalWorkgroupTuner& operator=(const NarwhalWorkgroupTuner&) = delete;
+
+		// The tuned shape, 8x8 for kernels that were never tuned on this device
+		NarwhalWorkgroupShape getShape(const std::string& kernel) const;
+		bool isTuned(const std::string& kernel) const;
+		// The candidates this device can run
+		const std::vector<NarwhalWorkgroupShape>& getCandidates() const { return candidates; }
+		// Whether the SPIR-V takes its local size from specialization constants 0 and 1, a binary built
+		// before that has the size baked in and only runs at the default shape
+		static bool isSpecializable(const std::string& spirvPath);
+
+		void startTuning(const std::string& kernel);
+		bool isTuning() const { return !tuningKernel.empty(); }
+		const std::string& getTuningKernel() const { return tuningKernel; }
+		// The candidate that still needs samples, only valid while tuning
+		NarwhalWorkgroupShape getTuningShape() const { return candidates[tuningCandidate]; }
+		float getTuningProgress() const;
+		// Time per unit of work of one dispatch. Finishing the last candidate picks the winner and saves it
+		void addSample(const std::string& kernel, NarwhalWorkgroupShape shape, float time);
+
+	private:
+		struct Entry {
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			std::string kernel;
+			NarwhalWorkgroupShape shape;
+		};
+
+		void load();
+		void save() const;
+		bool isThisDevice(const Entry& entry) const;
+
+		NarwhalDevice& narwhalDevice;
+		std::string path;
+		std::vector<NarwhalWorkgroupShape> candidates;
+		std::vector<Entry> entries; // Every device in the file, other devices are written back untouched
+
+		std::string tuningKernel;
+		uint32_t tuningCandidate = 0;
+		uint32_t tuningSamples = 0;
+		std::vector<float> bestTimes; // Per candidate
+	};
+}
@@ -0,0 +1,170 @@
+#include "black_hole_async_compute.hpp"
+
+#include "../narwhal_pipeline.hpp"
+
+//std
+#include <stdexcept>
+#include <cassert>
+
+
+namespace narwhal {
+	BlackHoleAsyncCompute::BlackHoleAsyncCompute(NarwhalDevice& device, NarwhalStorageImage& presentImage, NarwhalStorageImage& displayImage) :
+		narwhalDevice{ device }, presentImage{ presentImage }, displayImage{ displayImage }
+	{
+		computeFamily = narwhalDevice.getComputeQueueFamily();
+		graphicsFamily = narwhalDevice.getGraphicsQueueFamily();
+		createCommandBuffers();
+		clearPresentImage();
+	}
+
+	BlackHoleAsyncCompute::~BlackHoleAsyncCompute()
+	{
+		for (const NarwhalSubmission& submission : batchSubmissions) {
+			submission.wait();
+		}
+		vkFreeCommandBuffers(narwhalDevice.device(), narwhalDevice.getComputeCommandPool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	}
+
+	void BlackHoleAsyncCompute::createCommandBuffers()
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = narwhalDevice.getComputeCommandPool();
+		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+		if (vkAllocateCommandBuffers(narwhalDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate compute command buffers!");
+		}
+	}
+
+	void BlackHoleAsyncCompute::adoptImage(VkImage image, VkImageLayout layout)
+	{
+		// Same family means same queue, nothing to transfer
+		if (computeFamily == graphicsFamily) return;
+
+		VkCommandBuffer releaseCommandBuffer = narwhalDevice.beginSingleTimeCommands();
+		imageOwnershipBarrier(releaseCommandBuffer, image, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, graphicsFamily, computeFamily, layout);
+		NarwhalSubmission release = narwhalDevice.submitSingleTimeCommands(releaseCommandBuffer);
+
+		// The compute queue waits for the release on the gpu, only the acquire is waited on here
+		NarwhalCommandRing& computeRing = narwhalDevice.getCommandRing(NarwhalQueueType::Compute);
+		VkCommandBuffer acquireCommandBuffer = computeRing.begin();
+		imageOwnershipBarrier(acquireCommandBuffer, image, 0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, graphicsFamily, computeFamily, layout);
+		computeRing.submit(acquireCommandBuffer, release, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT).wait();
+	}
+
+	void BlackHoleAsyncCompute::resetPresentImage()
+	{
+		assert(!batchInProgress && "Cant reset the present image while a batch is in progress");
+
+		// Fresh images start out on the compute side like at load time, nothing to acquire or copy yet
+		presentOwnership = PresentOwnership::Compute;
+		presentRelease = {};
+		clearPresentImage();
+	}
+
+	void BlackHoleAsyncCompute::clearPresentImage()
+	{
+		// Blended resolves read it back before anything was swapped in, so it cant start out as garbage
+		VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands(NarwhalQueueType::Compute);
+		VkClearColorValue clearColor{};
+		VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdClearColorImage(commandBuffer, presentImage.getImage(), VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &range);
+		imageMemoryBarrier(commandBuffer, presentImage.getImage(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+		narwhalDevice.endSingleTimeCommands(commandBuffer, NarwhalQueueType::Compute);
+	}
+
+	VkCommandBuffer BlackHoleAsyncCompute::beginBatch()
+	{
+		assert(!batchInProgress && "Cant call beginBatch while a batch is already in progress");
+
+		// Never block the ui thread on a long integration, just skip this frame's batch
+		if (!batchSubmissions[batchIndex].isComplete()) {
+			return nullptr;
+		}
+
+		VkCommandBuffer commandBuffer = commandBuffers[batchIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording compute command buffer!");
+		}
+
+		batchInProgress = true;
+		waitForPresent = false;
+		releasedPresent = false;
+
+		// Acquire half of the transfer the last graphics frame released
+		if (presentOwnership == PresentOwnership::ReleasedToCompute) {
+			imageOwnershipBarrier(commandBuffer, presentImage.getImage(), 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, graphicsFamily, computeFamily);
+			presentOwnership = PresentOwnership::Compute;
+			waitForPresent = true;
+		}
+
+		return commandBuffer;
+	}
+
+	void BlackHoleAsyncCompute::releasePresentImage(VkCommandBuffer commandBuffer)
+	{
+		assert(batchInProgress && ownsPresentImage() && "Can only release the present image from a batch that owns it");
+
+		imageOwnershipBarrier(commandBuffer, presentImage.getImage(), VK_ACCESS_SHADER_WRITE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, computeFamily, graphicsFamily);
+		releasedPresent = true;
+	}
+
+	NarwhalSubmission BlackHoleAsyncCompute::endBatch()
+	{
+		assert(batchInProgress && "Cant call endBatch while no batch is in progress");
+		VkCommandBuffer commandBuffer = commandBuffers[batchIndex];
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record compute command buffer!");
+		}
+
+		NarwhalSubmitSync sync{};
+		if (waitForPresent) {
+			sync.wait(presentReturnRenderer->getLastSubmission(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+		NarwhalSubmission submission = narwhalDevice.submit(NarwhalQueueType::Compute, 1, &commandBuffer, sync);
+		batchSubmissions[batchIndex] = submission;
+
+		if (releasedPresent) {
+			presentOwnership = PresentOwnership::ReleasedToGraphics;
+			presentRelease = batchSubmissions[batchIndex];
+		}
+		batchInProgress = false;
+		batchIndex = (batchIndex + 1) % NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT;
+		return submission;
+	}
+
+	void BlackHoleAsyncCompute::recordDisplayCopy(VkCommandBuffer commandBuffer, NarwhalRenderer& renderer)
+	{
+		if (presentOwnership != PresentOwnership::ReleasedToGraphics) return; // Keep showing the last copy
+
+		imageOwnershipBarrier(commandBuffer, presentImage.getImage(), 0, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, computeFamily, graphicsFamily);
+		// Previous frames may still be sampling the display image
+		imageMemoryBarrier(commandBuffer, displayImage.getImage(), VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+
+		VkImageCopy region{};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.layerCount = 1;
+		region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.dstSubresource.layerCount = 1;
+		region.extent = { presentImage.getWidth(), presentImage.getHeight(), 1 };
+		vkCmdCopyImage(commandBuffer, presentImage.getImage(), VK_IMAGE_LAYOUT_GENERAL, displayImage.getImage(), VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+		imageMemoryBarrier(commandBuffer, displayImage.getImage(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+		// Give it straight back, compute acquires it on its next batch
+		imageOwnershipBarrier(commandBuffer, presentImage.getImage(), 0, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, graphicsFamily, computeFamily);
+
+		renderer.addWait(presentRelease, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		presentReturnRenderer = &renderer; // Its next endFrame is the submit the compute side waits on
+		presentOwnership = PresentOwnership::ReleasedToCompute;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../narwhal_device.hpp"
+#include "../narwhal_swap_chain.hpp"
+#include "../narwhal_storage_image.hpp"
+#include "../narwhal_renderer.hpp"
+
+//std
+#include <array>
+
+
+namespace narwhal {
+
+	// Who may touch the present image right now
+	enum class PresentOwnership {
+		Compute, // Compute batches resolve into it
+		ReleasedToGraphics, // A submitted batch released it, the next graphics frame copies it out
+		ReleasedToCompute, // The graphics frame handed it back, the next batch acquires it
+	};
+
+	// Runs the black hole passes on the device compute queue, decoupled from the display rate.
+	// The present image moves between queue families with ownership transfers ordered by the queue timelines,
+	// the graphics queue copies it into its own display image so the quad never waits on a long integration
+	class BlackHoleAsyncCompute
+	{
+	public:
+		BlackHoleAsyncCompute(NarwhalDevice& device, NarwhalStorageImage& presentImage, NarwhalStorageImage& displayImage);
+		~BlackHoleAsyncCompute();
+
+		BlackHoleAsyncCompute(const BlackHoleAsyncCompute&) = delete;
+		BlackHoleAsyncCompute& operator=(const BlackHoleAsyncCompute&) = delete;
+
+		// Returns a recording compute command buffer, or nullptr while every batch slot is still on the gpu
+		VkCommandBuffer beginBatch();
+		// Returns the submit so readbacks recorded into the batch can be tagged with it
+		NarwhalSubmission endBatch();
+		int getBatchIndex() const { return batchIndex; }
+
+		bool ownsPresentImage() const { return presentOwnership == PresentOwnership::Compute; }
+		// Call after the batch wrote the present image, the next graphics frame picks it up
+		void releasePresentImage(VkCommandBuffer commandBuffer);
+
+		// Call after the present and display images were recreated, drops the hand offs of the old images and clears the new present image
+		void resetPresentImage();
+
+		// Moves an image uploaded on the graphics queue over to the compute queue, blocks so only use it at load time
+		void adoptImage(VkImage image, VkImageLayout layout);
+
+		// Graphics side: if a new present image is waiting, copy it into the display image and hand it back
+		void recordDisplayCopy(VkCommandBuffer commandBuffer, NarwhalRenderer& renderer);
+
+	private:
+		void createCommandBuffers();
+		void clearPresentImage();
+
+		NarwhalDevice& narwhalDevice;
+		NarwhalStorageImage& presentImage;
+		NarwhalStorageImage& displayImage;
+
+		uint32_t computeFamily;
+		uint32_t graphicsFamily;
+
+		std::array<VkCommandBuffer, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT> commandBuffers{};
+		std::array<NarwhalSubmission, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT> batchSubmissions{};
+		NarwhalSubmission presentRelease{}; // Compute batch that released the present image to graphics
+		NarwhalRenderer* presentReturnRenderer = nullptr; // Its last frame handed the present image back to compute
+
+		int batchIndex = 0;
+		bool batchInProgress = false;
+		bool waitForPresent = false; // This batch acquired the present image back from graphics
+		bool releasedPresent = false; // This batch released the present image to graphics
+		PresentOwnership presentOwnership = PresentOwnership::Compute;
+	};
+}
@@ -6,33 +6,55 @@
 #include <stdexcept>
 #include <array>
 #include <iostream>
+#include <algorithm>
 
 
-constexpr auto COMP_LOCAL_X = 8.0f;
-constexpr auto COMP_LOCAL_Y = 8.0f;
+// Caps a single dispatch well under the OS GPU watchdog (TDR is ~2s on windows)
+constexpr int MAX_STEPS_PER_DISPATCH = 16384;
+constexpr float MAX_THROUGHPUT_DISPATCH_TIME = 100.f; // ms
+constexpr float MIN_COMPUTE_BUDGET = 1.f; // ms
+constexpr float COMPUTE_TIME_SMOOTHING = .8f;
 
 namespace narwhal {
-	BlackHoleComputeSystem::BlackHoleComputeSystem(NarwhalDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout setLayout): narwhalDevice{device}
+	BlackHoleComputeSystem::BlackHoleComputeSystem(NarwhalDevice& device, VkDescriptorSetLayout setLayout, BlackHoleType initialType): narwhalDevice{device}, workgroupTuner{device}
 	{
+		for (BlackHoleType type : { BlackHoleType::Schwarzchild, BlackHoleType::Kerr }) {
+			specializable[static_cast<size_t>(type)] = NarwhalWorkgroupTuner::isSpecializable(getShaderPath(type));
+		}
 		createPipelineLayout(setLayout);
-		createPipelines(renderPass);
-		VkPhysicalDeviceLimits limits = narwhalDevice.getLimits();
-		int maxZGroups = limits.maxComputeWorkGroupCount[2];
-		zGroups = std::min(2000,maxZGroups);
+		requestPipeline(initialType, getWorkgroupShape(initialType));
+		createTimestampQueries();
+		scheduleStats.maxStepsPerDispatch = MAX_STEPS_PER_DISPATCH;
+		scheduleSettings.fixedStepsPerDispatch = std::min(scheduleSettings.fixedStepsPerDispatch, scheduleStats.maxStepsPerDispatch);
+		scheduleStats.stepsPerDispatch = scheduleSettings.fixedStepsPerDispatch;
+		stepsScale = static_cast<float>(scheduleStats.stepsPerDispatch);
 	}
 	BlackHoleComputeSystem::~BlackHoleComputeSystem()
 	{
+		// Builds in flight still use the layout
+		for (auto& kv : pipelines) {
+			kv.second.join();
+		}
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(narwhalDevice.device(), timestampQueryPool, nullptr);
+		}
 		vkDestroyPipelineLayout(narwhalDevice.device(), pipelineLayout, nullptr);
 	}
 	void BlackHoleComputeSystem::createPipelineLayout(VkDescriptorSetLayout setLayout)
 	{
 		std::vector<VkDescriptorSetLayout> descriptorSetLayout{ setLayout };
-		
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(BlackHoleComputePush);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayout.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayout.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(narwhalDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 		{
@@ -40,35 +62,228 @@ namespace narwhal {
 		}
 	}
 
-	void BlackHoleComputeSystem::createPipelines(VkRenderPass renderPass)
+	const char* BlackHoleComputeSystem::getKernelName(BlackHoleType type)
+	{
+		return type == BlackHoleType::Schwarzchild ? "schwarzchildUpdate" : "kerrUpdate";
+	}
+
+	std::string BlackHoleComputeSystem::getShaderPath(BlackHoleType type)
+	{
+		return std::string("data/shaders/") + getKernelName(type) + ".comp.spv";
+	}
+
+	NarwhalWorkgroupShape BlackHoleComputeSystem::getTunedShape(BlackHoleType type) const
+	{
+		if (!canTuneWorkgroup(type)) return NarwhalWorkgroupShape{};
+		return workgroupTuner.getShape(getKernelName(type));
+	}
+
+	NarwhalWorkgroupShape BlackHoleComputeSystem::getWorkgroupShape(BlackHoleType type) const
+	{
+		const char* kernel = getKernelName(type);
+		if (workgroupTuner.isTuning() && workgroupTuner.getTuningKernel() == kernel) return workgroupTuner.getTuningShape();
+		return getTunedShape(type);
+	}
+
+	NarwhalPipelineHandle& BlackHoleComputeSystem::getPipelineHandle(BlackHoleType type, NarwhalWorkgroupShape shape)
+	{
+		uint32_t key = (static_cast<uint32_t>(type) << 16) | (shape.x << 8) | shape.y;
+		return pipelines[key];
+	}
+
+	void BlackHoleComputeSystem::requestPipeline(BlackHoleType type, NarwhalWorkgroupShape shape)
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
-		
-		PipelineConfigInfo pipelineConfig{};
-		NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
+		NarwhalPipelineHandle& handle = getPipelineHandle(type, shape);
+		if (handle.isValid()) return;
+
+		std::string shaderPath = getShaderPath(type);
+		handle = narwhalDevice.getPipelineCompiler().compile([this, shaderPath, shape]() {
+			NarwhalWorkgroupSpecialization specialization{ shape };
+			PipelineConfigInfo pipelineConfig{};
+			NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
+
+			pipelineConfig.pipelineLayout = pipelineLayout;
+			pipelineConfig.specializationInfo = &specialization.info;
+			return std::make_unique<NarwhalPipeline>(narwhalDevice, shaderPath, pipelineConfig);
+		});
+	}
+
+	NarwhalPipeline& BlackHoleComputeSystem::selectPipeline(BlackHoleType type, NarwhalWorkgroupShape& shape)
+	{
+		shape = getWorkgroupShape(type);
+		requestPipeline(type, shape);
+		NarwhalPipelineHandle& handle = getPipelineHandle(type, shape);
+
+		if (NarwhalPipeline* pipeline = handle.get()) {
+			if (usingFallback) pipelineSwapped = true;
+			usingFallback = false;
+			return *pipeline;
+		}
+
+		// A tuning candidate still building, the tuned shape traces the same metric
+		NarwhalWorkgroupShape tunedShape = getTunedShape(type);
+		if (NarwhalPipeline* pipeline = getPipelineHandle(type, tunedShape).get()) {
+			shape = tunedShape;
+			if (usingFallback) pipelineSwapped = true;
+			usingFallback = false;
+			return *pipeline;
+		}
+
+		// Trace with the other metric while the big kernel builds instead of freezing the ui on it
+		BlackHoleType otherType = type == BlackHoleType::Schwarzchild ? BlackHoleType::Kerr : BlackHoleType::Schwarzchild;
+		NarwhalWorkgroupShape otherShape = getTunedShape(otherType);
+		if (NarwhalPipeline* pipeline = getPipelineHandle(otherType, otherShape).get()) {
+			shape = otherShape;
+			usingFallback = true;
+			return *pipeline;
+		}
+
+		// Nothing built yet, only happens on the very first batch
+		usingFallback = false;
+		return handle.wait();
+	}
+
+	void BlackHoleComputeSystem::startWorkgroupTuning(BlackHoleType type)
+	{
+		// Tuning needs the dispatch times and a kernel that takes its size from the specialization constants
+		if (!scheduleStats.timestampsSupported || !canTuneWorkgroup(type)) return;
+
+		workgroupTuner.startTuning(getKernelName(type));
+		// All of them build in parallel while the first candidates run
+		for (const NarwhalWorkgroupShape& shape : workgroupTuner.getCandidates()) {
+			requestPipeline(type, shape);
+		}
+	}
+
+	bool BlackHoleComputeSystem::consumePipelineSwap()
+	{
+		bool swapped = pipelineSwapped;
+		pipelineSwapped = false;
+		return swapped;
+	}
+
+	void BlackHoleComputeSystem::createTimestampQueries()
+	{
+		// Without timestamps we cant measure the dispatch, so the budget modes fall back to the fixed size
+		uint32_t validBits = narwhalDevice.getQueueFamilyProperties(narwhalDevice.getComputeQueueFamily()).timestampValidBits;
+		scheduleStats.timestampsSupported = narwhalDevice.getLimits().timestampComputeAndGraphics && validBits > 0;
+		if (!scheduleStats.timestampsSupported) {
+			std::cout << "Timestamp queries not supported, compute scheduling will use a fixed dispatch size" << std::endl;
+			return;
+		}
+
+		timestampPeriod = narwhalDevice.getLimits().timestampPeriod;
+		timestampMask = validBits >= 64 ? ~0ULL : ((1ULL << validBits) - 1);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT * 2;
+
+		if (vkCreateQueryPool(narwhalDevice.device(), &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+	}
 
-		schwarzchildPipeline= std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/schwarzchildUpdate.comp.spv", pipelineConfig);
-		kerrPipeline = std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/kerrUpdate.comp.spv", pipelineConfig);
+	void BlackHoleComputeSystem::collectTimestamps(int frameIndex)
+	{
+		if (timestampQueryPool == VK_NULL_HANDLE || !timestampWritten[frameIndex]) return;
+
+		uint64_t timestamps[2];
+		VkResult result = vkGetQueryPoolResults(narwhalDevice.device(), timestampQueryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS) return; // VK_NOT_READY, try again next time this slot comes around
+
+		timestampWritten[frameIndex] = false;
+		uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+		float computeTime = static_cast<float>(ticks) * timestampPeriod / 1e6f;
+
+		const DispatchInfo& dispatch = timestampDispatches[frameIndex];
+		if (workgroupTuner.isTuning() && dispatch.work > 0.f) {
+			workgroupTuner.addSample(getKernelName(dispatch.type), dispatch.shape, computeTime / dispatch.work);
+		}
 
+		if (scheduleStats.computeTime <= 0.f) {
+			scheduleStats.computeTime = computeTime;
+		}
+		else {
+			scheduleStats.computeTime = COMPUTE_TIME_SMOOTHING * scheduleStats.computeTime + (1.f - COMPUTE_TIME_SMOOTHING) * computeTime;
+		}
+		hasNewTimestamp = true;
 	}
 
-	void BlackHoleComputeSystem::render(BlackHoleFrameInfo& frameInfo,BlackHoleParameters& parameters, VkExtent2D& size)
+	void BlackHoleComputeSystem::updateSchedule(float frameTime)
 	{
-		vkResetFences(narwhalDevice.device(), 1, &frameInfo.computeFence);
-		VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands();
-		NarwhalPipeline& pipeline = parameters.blackHoleType == BlackHoleType::Schwarzchild ? *schwarzchildPipeline : *kerrPipeline;
+		const int maxStepsPerDispatch = scheduleStats.maxStepsPerDispatch;
+
+		if (scheduleSettings.mode == ComputeScheduleMode::Fixed || !scheduleStats.timestampsSupported) {
+			scheduleStats.stepsPerDispatch = std::clamp(scheduleSettings.fixedStepsPerDispatch, 1, maxStepsPerDispatch);
+			stepsScale = static_cast<float>(scheduleStats.stepsPerDispatch);
+			return;
+		}
+
+		// Only react to fresh measurements, otherwise we would keep scaling on the same sample
+		if (!hasNewTimestamp || scheduleStats.computeTime <= 0.f) return;
+		hasNewTimestamp = false;
+
+		float budget;
+		if (scheduleSettings.mode == ComputeScheduleMode::MaxThroughput) {
+			budget = MAX_THROUGHPUT_DISPATCH_TIME;
+		}
+		else {
+			// Whatever the frame spends outside of the dispatch (ui, present, cpu) is not ours to spend
+			float otherFrameTime = std::max(0.f, frameTime * 1000.f - scheduleStats.computeTime);
+			budget = std::max(MIN_COMPUTE_BUDGET, scheduleSettings.targetFrameTime - otherFrameTime);
+		}
+
+		// Dispatch time is roughly linear in the steps per dispatch, damp the correction so it doesnt oscillate
+		float ratio = std::clamp(budget / scheduleStats.computeTime, .5f, 1.5f);
+		stepsScale = std::clamp(stepsScale * ratio, 1.f, static_cast<float>(maxStepsPerDispatch));
+		scheduleStats.stepsPerDispatch = static_cast<int>(stepsScale);
+	}
+
+	void BlackHoleComputeSystem::render(BlackHoleFrameInfo& frameInfo,BlackHoleParameters& parameters, BlackHoleTileScheduler& tileScheduler)
+	{
+		collectTimestamps(frameInfo.frameIndex);
+		updateSchedule(frameInfo.frameTime);
+
+		uint32_t tileCount = tileScheduler.buildTileList(frameInfo.frameIndex);
+		if (tileCount == 0) return; // Everything converged, nothing to launch
+
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		// Previous frames may still be reading or writing the trace images
+		memoryBarrier(commandBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		NarwhalWorkgroupShape shape;
+		NarwhalPipeline& pipeline = selectPipeline(parameters.blackHoleType, shape);
 		pipeline.bind(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE);
-		
+
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frameInfo.computeDescriptorSet, 0, nullptr);
-		int groupsX= (int) ceil( size.width/ COMP_LOCAL_X);
-		int groupsY = (int)ceil(size.height / COMP_LOCAL_Y);
-		
-		vkCmdDispatch(commandBuffer, groupsX, groupsY, zGroups);
 
-		narwhalDevice.endSingleTimeCommands(commandBuffer,frameInfo.computeFence);
-		
+		BlackHoleComputePush push = frameInfo.push;
+		push.frameIndex = dispatchCount++;
+		push.stepsPerDispatch = scheduleStats.stepsPerDispatch;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BlackHoleComputePush), &push);
+		// x walks the groups inside a tile, y picks the tile from this frame's tile list
+		uint32_t groupsPerTile = shape.groupsX(TILE_SIZE) * shape.groupsY(TILE_SIZE);
+
+		uint32_t firstQuery = frameInfo.frameIndex * 2;
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, timestampQueryPool, firstQuery, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, firstQuery);
+		}
+
+		vkCmdDispatch(commandBuffer, groupsPerTile, tileCount, 1);
+
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, firstQuery + 1);
+			timestampWritten[frameInfo.frameIndex] = true;
+			timestampDispatches[frameInfo.frameIndex] = DispatchInfo{ parameters.blackHoleType, shape, static_cast<float>(tileCount) * scheduleStats.stepsPerDispatch };
+		}
+
+		tileScheduler.recordReadback(commandBuffer);
+
 	}
 }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "../narwhal_pipeline.hpp"
+#include "../narwhal_pipeline_compiler.hpp"
+#include "../narwhal_workgroup_tuner.hpp"
 #include "../narwhal_device.hpp"
 #include "../narwhal_camera.hpp"
 #include "../narwhal_frame_info.hpp"
+#include "../narwhal_swap_chain.hpp"
+#include "black_hole_tile_scheduler.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -14,32 +18,102 @@
 //std
 #include <memory>
 #include <vector>
+#include <array>
+#include <unordered_map>
 
 
 namespace narwhal {
+
+	enum class ComputeScheduleMode {
+		Fixed, // Always integrate fixedStepsPerDispatch steps
+		FrameBudget, // Adapt the layers so the frame hits targetFrameTime
+		MaxThroughput, // Offline rendering, make each dispatch as big as the driver watchdog allows
+	};
+
+	struct ComputeScheduleSettings {
+		ComputeScheduleMode mode = ComputeScheduleMode::FrameBudget;
+		float targetFrameTime = 16.f; // ms
+		int fixedStepsPerDispatch = 2000;
+	};
+
+	struct ComputeScheduleStats {
+		float computeTime = 0.f; // ms, smoothed GPU time of the update dispatch
+		int stepsPerDispatch = 0;
+		int maxStepsPerDispatch = 0;
+		bool timestampsSupported = false;
+	};
+
 	class BlackHoleComputeSystem
 	{
 	public:
 
-		BlackHoleComputeSystem(NarwhalDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout setLayout);
+		// Only the initial type gets compiled up front, the other one on first use
+		BlackHoleComputeSystem(NarwhalDevice& device, VkDescriptorSetLayout setLayout, BlackHoleType initialType = BlackHoleType::Schwarzchild);
 		~BlackHoleComputeSystem();
 
 		BlackHoleComputeSystem(const BlackHoleComputeSystem&) = delete; // Remove copy constructor
 		BlackHoleComputeSystem& operator=(const BlackHoleComputeSystem&) = delete; // Remove copy assignment operator
 
-		void render(BlackHoleFrameInfo& frameInfo, BlackHoleParameters& parameters, VkExtent2D& size);
+		void render(BlackHoleFrameInfo& frameInfo, BlackHoleParameters& parameters, BlackHoleTileScheduler& tileScheduler);
+
+		ComputeScheduleSettings& getScheduleSettings() { return scheduleSettings; }
+		const ComputeScheduleStats& getScheduleStats() const { return scheduleStats; }
+
+		// The requested type is still compiling and the other one traces in its place
+		bool isUsingFallback() const { return usingFallback; }
+		// True once after the real pipeline replaced the fallback, the trace so far is the wrong metric
+		bool consumePipelineSwap();
+
+		// Runs every candidate work group shape of the type's kernel on the next batches and keeps the fastest
+		void startWorkgroupTuning(BlackHoleType type);
+		// False when the loaded kernel has its work group size baked in
+		bool canTuneWorkgroup(BlackHoleType type) const { return specializable[static_cast<size_t>(type)]; }
+		const NarwhalWorkgroupTuner& getWorkgroupTuner() const { return workgroupTuner; }
+		// The shape the type dispatches with right now
+		NarwhalWorkgroupShape getWorkgroupShape(BlackHoleType type) const;
+		static const char* getKernelName(BlackHoleType type);
 
 	private:
+		static std::string getShaderPath(BlackHoleType type);
+		// What the timestamps of a frame slot measured
+		struct DispatchInfo {
+			BlackHoleType type = BlackHoleType::Schwarzchild;
+			NarwhalWorkgroupShape shape{};
+			float work = 0.f; // Tiles times steps
+		};
+
 		void createPipelineLayout(VkDescriptorSetLayout setLayout);
-		void createPipelines(VkRenderPass renderPass);
+		NarwhalPipelineHandle& getPipelineHandle(BlackHoleType type, NarwhalWorkgroupShape shape);
+		// The tuned shape, or the default when the kernel cant be specialized
+		NarwhalWorkgroupShape getTunedShape(BlackHoleType type) const;
+		void requestPipeline(BlackHoleType type, NarwhalWorkgroupShape shape);
+		NarwhalPipeline& selectPipeline(BlackHoleType type, NarwhalWorkgroupShape& shape);
+		void createTimestampQueries();
+
+		void collectTimestamps(int frameIndex);
+		void updateSchedule(float frameTime);
 
 		NarwhalDevice &narwhalDevice;
 
-		std::unique_ptr<NarwhalPipeline> schwarzchildPipeline;
-		std::unique_ptr<NarwhalPipeline> kerrPipeline;
+		std::unordered_map<uint32_t, NarwhalPipelineHandle> pipelines; // Per type and work group shape
+		NarwhalWorkgroupTuner workgroupTuner;
+		std::array<bool, 2> specializable{}; // Per type
 		VkPipelineLayout pipelineLayout;
+		bool usingFallback = false;
+		bool pipelineSwapped = false;
+
+		// Two timestamps (start,end) per frame in flight
+		VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+		float timestampPeriod = 1.f; // ns per tick
+		uint64_t timestampMask = ~0ULL;
+		std::array<bool, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT> timestampWritten{};
+		std::array<DispatchInfo, NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT> timestampDispatches{};
+		bool hasNewTimestamp = false;
 
-		int zGroups = 0;
+		ComputeScheduleSettings scheduleSettings{};
+		ComputeScheduleStats scheduleStats{};
+		float stepsScale = 0.f; // Fractional steps so small corrections are not lost to rounding
+		uint32_t dispatchCount = 0; // Goes to the shaders as the frame index
 	};
 }
 
@@ -8,28 +8,32 @@
 #include <iostream>
 
 
-constexpr auto COMP_LOCAL_X = 8.0f;
-constexpr auto COMP_LOCAL_Y = 8.0f;
-
 namespace narwhal {
-	BlackHoleInitSystem::BlackHoleInitSystem(NarwhalDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout setLayout): narwhalDevice{device}
+	BlackHoleInitSystem::BlackHoleInitSystem(NarwhalDevice& device, VkDescriptorSetLayout setLayout): narwhalDevice{device}
 	{
 		createPipelineLayout(setLayout);
-		createPipelines(renderPass);
+		createPipelines();
 	}
 	BlackHoleInitSystem::~BlackHoleInitSystem()
 	{
+		pipeline.join(); // The build may still be using the layout
 		vkDestroyPipelineLayout(narwhalDevice.device(), pipelineLayout, nullptr);
 	}
 	void BlackHoleInitSystem::createPipelineLayout(VkDescriptorSetLayout setLayout)
 	{
 		std::vector<VkDescriptorSetLayout> descriptorSetLayout{ setLayout };
 		
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(InitPush);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayout.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayout.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(narwhalDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 		{
@@ -37,34 +41,36 @@ namespace narwhal {
 		}
 	}
 
-	void BlackHoleInitSystem::createPipelines(VkRenderPass renderPass)
+	void BlackHoleInitSystem::createPipelines()
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
-		
-		PipelineConfigInfo pipelineConfig{};
-		NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipeline = narwhalDevice.getPipelineCompiler().compile([this]() {
+			NarwhalWorkgroupSpecialization specialization{ workgroupShape };
+			PipelineConfigInfo pipelineConfig{};
+			NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
 
-		pipeline= std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/frameInit.comp.spv", pipelineConfig);
-		
+			pipelineConfig.pipelineLayout = pipelineLayout;
+			pipelineConfig.specializationInfo = &specialization.info;
 
+			return std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/frameInit.comp.spv", pipelineConfig);
+		});
 	}
 
-	void BlackHoleInitSystem::initFrame(InitFrameInfo& frameInfo,VkExtent2D& size)
+	void BlackHoleInitSystem::initFrame(InitFrameInfo& frameInfo,VkExtent2D& size, BlackHoleTileScheduler& tileScheduler)
 	{
-		vkResetFences(narwhalDevice.device(), 1, &frameInfo.computeFence);
-		VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands();
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		tileScheduler.invalidate();
+		tileScheduler.recordReset(commandBuffer);
+
+		// The init pass overwrites images the previous frames may still be tracing or presenting
+		memoryBarrier(commandBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 		
-		pipeline->bind(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE);
+		pipeline.wait().bind(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE);
 		
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frameInfo.initDescriptorSet, 0, nullptr);
-		int groupsX= (int) ceil( size.width/ COMP_LOCAL_X);
-		int groupsY = (int)ceil(size.height / COMP_LOCAL_Y);
-		vkCmdDispatch(commandBuffer, groupsX,groupsY, 1); //TODO: Calculate dispatch size
-
-		narwhalDevice.endSingleTimeCommands(commandBuffer,frameInfo.computeFence);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(InitPush), &frameInfo.push);
+		vkCmdDispatch(commandBuffer, workgroupShape.groupsX(size.width), workgroupShape.groupsY(size.height), 1);
 		
 	}
 }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "../narwhal_pipeline.hpp"
+#include "../narwhal_pipeline_compiler.hpp"
+#include "../narwhal_workgroup_tuner.hpp"
 #include "../narwhal_device.hpp"
 #include "../narwhal_camera.hpp"
 #include "../narwhal_frame_info.hpp"
+#include "black_hole_tile_scheduler.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -21,22 +24,23 @@ namespace narwhal {
 	{
 	public:
 
-		BlackHoleInitSystem(NarwhalDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout setLayout);
+		BlackHoleInitSystem(NarwhalDevice& device, VkDescriptorSetLayout setLayout);
 		~BlackHoleInitSystem();
 
 		BlackHoleInitSystem(const BlackHoleInitSystem&) = delete; // Remove copy constructor
 		BlackHoleInitSystem& operator=(const BlackHoleInitSystem&) = delete; // Remove copy assignment operator
 
-		void initFrame(InitFrameInfo& frameInfo, VkExtent2D& size);
+		void initFrame(InitFrameInfo& frameInfo, VkExtent2D& size, BlackHoleTileScheduler& tileScheduler);
 
 	private:
 		void createPipelineLayout(VkDescriptorSetLayout setLayout);
-		void createPipelines(VkRenderPass renderPass);
+		void createPipelines();
 
 		NarwhalDevice &narwhalDevice;
 
-		std::unique_ptr<NarwhalPipeline> pipeline;
+		NarwhalPipelineHandle pipeline; // Built on the compiler threads, waited on at first use
 		VkPipelineLayout pipelineLayout;
+		NarwhalWorkgroupShape workgroupShape{}; // 8x8 divides TILE_SIZE, a group never straddles two tiles
 	};
 }
 
@@ -0,0 +1,88 @@
+#include "black_hole_present_system.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//std
+#include <stdexcept>
+#include <array>
+#include <iostream>
+
+
+namespace narwhal {
+
+	struct PresentPushConstantData {
+		glm::ivec2 windowSize;
+		int mode;
+		float blendFactor;
+	};
+
+	BlackHolePresentSystem::BlackHolePresentSystem(NarwhalDevice& device, VkDescriptorSetLayout setLayout) : narwhalDevice{ device }
+	{
+		createPipelineLayout(setLayout);
+		createPipelines();
+	}
+	BlackHolePresentSystem::~BlackHolePresentSystem()
+	{
+		pipeline.join(); // The build may still be using the layout
+		vkDestroyPipelineLayout(narwhalDevice.device(), pipelineLayout, nullptr);
+	}
+	void BlackHolePresentSystem::createPipelineLayout(VkDescriptorSetLayout setLayout)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PresentPushConstantData);
+
+		std::vector<VkDescriptorSetLayout> descriptorSetLayout{ setLayout };
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayout.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayout.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(narwhalDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+	}
+
+	void BlackHolePresentSystem::createPipelines()
+	{
+		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+		pipeline = narwhalDevice.getPipelineCompiler().compile([this]() {
+			NarwhalWorkgroupSpecialization specialization{ workgroupShape };
+			PipelineConfigInfo pipelineConfig{};
+			NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
+
+			pipelineConfig.pipelineLayout = pipelineLayout;
+			pipelineConfig.specializationInfo = &specialization.info;
+
+			return std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/presentResolve.comp.spv", pipelineConfig);
+		});
+	}
+
+	void BlackHolePresentSystem::resolve(PresentFrameInfo& frameInfo, PresentResolveMode mode, float blendFactor, VkExtent2D& size)
+	{
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		// Waits on the trace writes, the graphics queue reads are covered by the ownership transfer
+		memoryBarrier(commandBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		pipeline.wait().bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frameInfo.presentDescriptorSet, 0, nullptr);
+
+		PresentPushConstantData push{};
+		push.windowSize = glm::ivec2(size.width, size.height);
+		push.mode = static_cast<int>(mode);
+		push.blendFactor = blendFactor;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PresentPushConstantData), &push);
+
+		vkCmdDispatch(commandBuffer, workgroupShape.groupsX(size.width), workgroupShape.groupsY(size.height), 1);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../narwhal_pipeline.hpp"
+#include "../narwhal_pipeline_compiler.hpp"
+#include "../narwhal_workgroup_tuner.hpp"
+#include "../narwhal_device.hpp"
+#include "../narwhal_frame_info.hpp"
+
+//std
+#include <memory>
+#include <vector>
+
+
+namespace narwhal {
+
+	enum class PresentSwapPolicy {
+		OnConvergence, // Swap once the trace stops making progress
+		OnThreshold, // Swap when the completed fraction crosses the frame threshold
+		Blended, // Blend every completed pixel into the present image as it finishes
+	};
+
+	enum class PresentResolveMode {
+		Copy, // Present image takes the whole accumulation image
+		Blend, // Only completed pixels are blended into the present image
+		Position, // Debug views, overwrite the present image with the raw trace state
+		Direction,
+		IsComplete,
+	};
+
+	class BlackHolePresentSystem
+	{
+	public:
+
+		BlackHolePresentSystem(NarwhalDevice& device, VkDescriptorSetLayout setLayout);
+		~BlackHolePresentSystem();
+
+		BlackHolePresentSystem(const BlackHolePresentSystem&) = delete; // Remove copy constructor
+		BlackHolePresentSystem& operator=(const BlackHolePresentSystem&) = delete; // Remove copy assignment operator
+
+		void resolve(PresentFrameInfo& frameInfo, PresentResolveMode mode, float blendFactor, VkExtent2D& size);
+
+	private:
+		void createPipelineLayout(VkDescriptorSetLayout setLayout);
+		void createPipelines();
+
+		NarwhalDevice& narwhalDevice;
+
+		NarwhalPipelineHandle pipeline; // Built on the compiler threads, waited on at first use
+		VkPipelineLayout pipelineLayout;
+		NarwhalWorkgroupShape workgroupShape{}; // Cheap full screen pass, not worth tuning
+	};
+}
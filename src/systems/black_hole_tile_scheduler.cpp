@@ -0,0 +1,165 @@
+#include "black_hole_tile_scheduler.hpp"
+
+#include "../narwhal_pipeline.hpp"
+
+//std
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+
+constexpr float LUMINANCE_SCALE = 256.f; // Must match the update shaders
+
+namespace narwhal {
+	BlackHoleTileScheduler::BlackHoleTileScheduler(NarwhalDevice& device, NarwhalReadback& readback, VkExtent2D size) : narwhalDevice{ device }, readback{ readback }, extent{ size }
+	{
+		// The shaders reduce their counters per subgroup before touching the tile atomics
+		VkPhysicalDeviceSubgroupProperties subgroupProperties = narwhalDevice.getSubgroupProperties();
+		VkSubgroupFeatureFlags requiredOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+		if ((subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) == 0 || (subgroupProperties.supportedOperations & requiredOperations) != requiredOperations) {
+			throw std::runtime_error("device does not support subgroup arithmetic in compute shaders!");
+		}
+
+		createBuffers();
+	}
+
+	void BlackHoleTileScheduler::resize(VkExtent2D size)
+	{
+		// Batches in flight still read the old counters and tile lists
+		NarwhalDeletionQueue& deletionQueue = narwhalDevice.getDeletionQueue();
+		deletionQueue.retire(std::move(tileStateBuffer));
+		for (auto& tileListBuffer : tileListBuffers) {
+			deletionQueue.retire(std::move(tileListBuffer));
+		}
+
+		extent = size;
+		createBuffers();
+	}
+
+	void BlackHoleTileScheduler::createBuffers()
+	{
+		tileCount = glm::ivec2((extent.width + TILE_SIZE - 1) / TILE_SIZE, (extent.height + TILE_SIZE - 1) / TILE_SIZE);
+		uint32_t totalTiles = tileCount.x * tileCount.y;
+
+		// Device local, the shaders hammer it with atomics and the cpu only sees it through readbacks
+		tileStateBuffer = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(TileState), totalTiles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, NarwhalMemoryCategory::RayState);
+		VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands(NarwhalQueueType::Compute);
+		vkCmdFillBuffer(commandBuffer, tileStateBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+		narwhalDevice.endSingleTimeCommands(commandBuffer, NarwhalQueueType::Compute);
+
+		tileListBuffers.resize(NarwhalSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& tileListBuffer : tileListBuffers) {
+			tileListBuffer = std::make_unique<NarwhalBuffer>(narwhalDevice, sizeof(uint32_t), totalTiles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1, NarwhalMemoryCategory::RayState);
+			tileListBuffer->map();
+		}
+
+		tileStates.assign(totalTiles, TileState{});
+		generation++;
+		countersValid = false;
+		sortedTiles.clear();
+		sortedTiles.reserve(totalTiles);
+
+		stats = {};
+		stats.totalTiles = totalTiles;
+	}
+
+	void BlackHoleTileScheduler::invalidate()
+	{
+		generation++;
+		countersValid = false;
+	}
+
+	void BlackHoleTileScheduler::recordReset(VkCommandBuffer commandBuffer)
+	{
+		// The init pass accumulates the active counts on top of zero
+		bufferMemoryBarrier(commandBuffer, tileStateBuffer->getBuffer(), VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdFillBuffer(commandBuffer, tileStateBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+		bufferMemoryBarrier(commandBuffer, tileStateBuffer->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+
+	void BlackHoleTileScheduler::recordReadback(VkCommandBuffer commandBuffer)
+	{
+		uint32_t readGeneration = generation;
+		VkDeviceSize size = tileStates.size() * sizeof(TileState);
+		// A dropped request just means the scheduler works from older counters for a bit
+		readback.readBuffer(commandBuffer, NarwhalQueueType::Compute, tileStateBuffer->getBuffer(), 0, size,
+			[this, readGeneration](const void* data, VkDeviceSize size) {
+				if (readGeneration != generation || size != tileStates.size() * sizeof(TileState)) return;
+				memcpy(tileStates.data(), data, static_cast<size_t>(size));
+				countersValid = true;
+				updateStats();
+			});
+	}
+
+	void BlackHoleTileScheduler::updateStats()
+	{
+		int activePixels = 0;
+		int activeTiles = 0;
+		for (const TileState& state : tileStates) {
+			if (state.activeCount > 0) {
+				activePixels += state.activeCount;
+				activeTiles++;
+			}
+		}
+
+		int totalPixels = extent.width * extent.height;
+		stats.activeTiles = activeTiles;
+		stats.completedFraction = totalPixels > 0 ? 1.f - (float)activePixels / (float)totalPixels : 1.f;
+	}
+
+	float BlackHoleTileScheduler::tilePriority(int tileIndex, const TileState& state) const
+	{
+		// Centre tiles first, that's where the lensing happens and where the eye goes
+		glm::vec2 tileCentre = (glm::vec2(tileIndex % tileCount.x, tileIndex / tileCount.x) + .5f) * (float)TILE_SIZE;
+		glm::vec2 screenCentre = glm::vec2(extent.width, extent.height) * .5f;
+		float centre = 1.f - glm::clamp(glm::length(tileCentre - screenCentre) / glm::length(screenCentre), 0.f, 1.f);
+
+		// Tiles with noisy finished pixels (disk edges, einstein ring) benefit the most from finishing
+		float variance = 0.f;
+		if (state.completedCount > 1) {
+			float mean = state.luminanceSum / LUMINANCE_SCALE / state.completedCount;
+			float meanSq = state.luminanceSqSum / LUMINANCE_SCALE / state.completedCount;
+			float v = glm::max(meanSq - mean * mean, 0.f);
+			variance = v / (1.f + v);
+		}
+		return settings.centreWeight * centre + settings.varianceWeight * variance;
+	}
+
+	uint32_t BlackHoleTileScheduler::buildTileList(int frameIndex)
+	{
+		// Until the first readback of this trace arrives every tile counts as active
+		bool countersStale = !countersValid;
+		if (countersStale) {
+			stats.activeTiles = stats.totalTiles;
+			stats.completedFraction = 0.f;
+		}
+
+		sortedTiles.clear();
+		for (int i = 0; i < (int)tileStates.size(); i++) {
+			if (countersStale) {
+				sortedTiles.emplace_back(tilePriority(i, TileState{}), (uint32_t)i);
+				continue;
+			}
+			if (tileStates[i].activeCount <= 0) continue; // Converged, no groups launched for it
+			sortedTiles.emplace_back(tilePriority(i, tileStates[i]), (uint32_t)i);
+		}
+
+		uint32_t count = (uint32_t)sortedTiles.size();
+		if (settings.tilesPerDispatch > 0) {
+			count = std::min(count, (uint32_t)settings.tilesPerDispatch);
+		}
+
+		// Only the dispatched prefix needs to be in order
+		std::partial_sort(sortedTiles.begin(), sortedTiles.begin() + count, sortedTiles.end(),
+			[](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
+
+		uint32_t* tileList = static_cast<uint32_t*>(tileListBuffers[frameIndex]->getMappedMemory());
+		for (uint32_t i = 0; i < count; i++) {
+			tileList[i] = sortedTiles[i].second;
+		}
+
+		stats.dispatchedTiles = count;
+		return count;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../narwhal_device.hpp"
+#include "../narwhal_buffer.hpp"
+#include "../narwhal_swap_chain.hpp"
+#include "../narwhal_readback.hpp"
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//std
+#include <memory>
+#include <vector>
+
+
+namespace narwhal {
+
+	// Must match TILE_SIZE in frameInit.comp and the update shaders
+	constexpr int TILE_SIZE = 64;
+
+	// Per tile counters written by the shaders, std430 layout
+	struct TileState {
+		int activeCount; // Pixels still integrating
+		uint32_t completedCount;
+		uint32_t luminanceSum; // Fixed point, see LUMINANCE_SCALE in the shaders
+		uint32_t luminanceSqSum;
+	};
+
+	struct TileSchedulerSettings {
+		int tilesPerDispatch = 0; // 0 dispatches every active tile
+		float centreWeight = 1.f;
+		float varianceWeight = 1.f;
+	};
+
+	struct TileSchedulerStats {
+		int totalTiles = 0;
+		int activeTiles = 0;
+		int dispatchedTiles = 0;
+		float completedFraction = 0.f;
+	};
+
+	class BlackHoleTileScheduler
+	{
+	public:
+		BlackHoleTileScheduler(NarwhalDevice& device, NarwhalReadback& readback, VkExtent2D size);
+
+		BlackHoleTileScheduler(const BlackHoleTileScheduler&) = delete;
+		BlackHoleTileScheduler& operator=(const BlackHoleTileScheduler&) = delete;
+
+		void resize(VkExtent2D size);
+
+		// Marks every tile as restarted, the next init pass repopulates the counters
+		void invalidate();
+		void recordReset(VkCommandBuffer commandBuffer);
+		// Copies the counters out after the update pass, they reach the cpu once the batch finished
+		void recordReadback(VkCommandBuffer commandBuffer);
+
+		// Writes the priority ordered active tiles into this frame's list from the latest counters that
+		// came back, returns how many tiles to dispatch. The counters lag the batches still in flight
+		uint32_t buildTileList(int frameIndex);
+
+		glm::ivec2 getTileCount() const { return tileCount; }
+		VkDescriptorBufferInfo getTileStateBufferInfo() { return tileStateBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo getTileListBufferInfo(int frameIndex) { return tileListBuffers[frameIndex]->descriptorInfo(); }
+
+		TileSchedulerSettings& getSettings() { return settings; }
+		const TileSchedulerStats& getStats() const { return stats; }
+
+	private:
+		void createBuffers();
+		void updateStats();
+		float tilePriority(int tileIndex, const TileState& state) const;
+
+		NarwhalDevice& narwhalDevice;
+		NarwhalReadback& readback;
+
+		VkExtent2D extent;
+		glm::ivec2 tileCount{ 0 };
+
+		std::unique_ptr<NarwhalBuffer> tileStateBuffer;
+		std::vector<std::unique_ptr<NarwhalBuffer>> tileListBuffers;
+
+		std::vector<TileState> tileStates;
+		std::vector<std::pair<float, uint32_t>> sortedTiles; // Kept around to avoid reallocating every frame
+		uint32_t generation = 0; // Bumped on every reset, readbacks of older traces get dropped
+		bool countersValid = false; // A readback of the current trace has arrived
+
+		TileSchedulerSettings settings{};
+		TileSchedulerStats stats{};
+	};
+}
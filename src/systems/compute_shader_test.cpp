@@ -138,7 +138,6 @@ namespace narwhal {
 	}*/
 
 	void ComputeTestSystem::render(FrameInfo& frameInfo) {
-		vkResetFences(narwhalDevice.device(), 1, &frameInfo.computeFence);
 		VkCommandBuffer commandBuffer = narwhalDevice.beginSingleTimeCommands();
 		
 		narwhalPipeline->bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE);
@@ -146,7 +145,8 @@ namespace narwhal {
 		vkCmdDispatch(commandBuffer, 1, 1, 1);
 
 
-		narwhalDevice.endSingleTimeCommands(commandBuffer,frameInfo.computeFence);
+		// The frame's vertex pass reads the results, so wait on this submit before recording continues
+		narwhalDevice.endSingleTimeCommands(commandBuffer);
 	}
 
 }
\ No newline at end of file
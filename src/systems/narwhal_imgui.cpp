@@ -2,6 +2,7 @@
 
 #include "../narwhal_device.hpp"
 #include "../narwhal_window.hpp"
+#include "../narwhal_pipeline_cache.hpp"
 
 // libs
 #include <imgui.h>
@@ -20,19 +21,11 @@ namespace narwhal
     {
         
         //Make the descriptor pool
+        // The backend allocates from a raw pool itself so it can't use a growable allocator. It only ever
+        // makes combined image sampler sets, one for the font and one per texture handed to ImGui::Image
         descriptorPool = NarwhalDescriptorPool::Builder(device)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000)
-            .setMaxSets(1000 * 11)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64)
+            .setMaxSets(64)
             .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
             .build();
 
@@ -59,8 +52,8 @@ namespace narwhal
         init_info.QueueFamily = device.getGraphicsQueueFamily();
         init_info.Queue = device.graphicsQueue();
 
-        // pipeline cache is a potential future optimization, ignoring for now
-        init_info.PipelineCache = VK_NULL_HANDLE;
+        // Shares the device's on-disk pipeline cache
+        init_info.PipelineCache = device.getPipelineCache().getPipelineCache();
 		init_info.DescriptorPool = descriptorPool->getDescriptorPool();
         // todo, I should probably get around to integrating a memory allocator library such as Vulkan
         // memory allocator (VMA) sooner than later. We don't want to have to update adding an allocator
@@ -75,14 +68,18 @@ namespace narwhal
         // which can be done easily bye using some existing helper functions on the lve device object
         auto commandBuffer = device.beginSingleTimeCommands();
         ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
-        device.endSingleTimeCommands(commandBuffer);
+        device.submitSingleTimeCommands(commandBuffer).wait(); // The upload objects below get destroyed, so wait on this submit only
         ImGui_ImplVulkan_DestroyFontUploadObjects();
+
+        // The backend allocates its own memory, the font atlas is the only sizeable part of it. Rgba32 on the gpu
+        fontTextureSize = static_cast<VkDeviceSize>(io.Fonts->TexWidth) * io.Fonts->TexHeight * 4;
+        device.getAllocator().trackExternal(NarwhalMemoryCategory::UI, fontTextureSize);
     }
 
     NarwhalImgui::~NarwhalImgui()
     {
         // Cleanup
-      
+        narwhalDevice.getAllocator().untrackExternal(NarwhalMemoryCategory::UI, fontTextureSize);
         ImGui_ImplVulkan_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
@@ -53,6 +53,7 @@ namespace narwhal {
 
 		NarwhalDevice &narwhalDevice;
         std::unique_ptr<NarwhalDescriptorPool> descriptorPool{};
+        VkDeviceSize fontTextureSize = 0;
 
 		
 
@@ -28,6 +28,7 @@ namespace narwhal {
 
 	PointLightSystem::~PointLightSystem()
 	{
+		narwhalPipeline.join(); // The build may still be using the layout
 		vkDestroyPipelineLayout(narwhalDevice.device(), pipelineLayout, nullptr);
 	}
 
@@ -58,15 +59,16 @@ namespace narwhal {
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
-		PipelineConfigInfo pipelineConfig{};
-		NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.attributeDescriptions.clear();
-		pipelineConfig.bindingDescriptions.clear();
-
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		narwhalPipeline = std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/point_light.vert.spv", "data/shaders/point_light.frag.spv", pipelineConfig);
+		narwhalPipeline = narwhalDevice.getPipelineCompiler().compile([this, renderPass]() {
+			PipelineConfigInfo pipelineConfig{};
+			NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
+			pipelineConfig.attributeDescriptions.clear();
+			pipelineConfig.bindingDescriptions.clear();
 
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = pipelineLayout;
+			return std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/point_light.vert.spv", "data/shaders/point_light.frag.spv", pipelineConfig);
+		});
 	}
 
 	void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo)	{
@@ -91,10 +93,10 @@ namespace narwhal {
 	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo){
-		narwhalPipeline->bind(frameInfo.commandBuffer);
+		narwhalPipeline.wait().bind(frameInfo.commandBuffer);
 
 
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
 		vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 
 		
@@ -16,6 +16,7 @@ namespace narwhal {
 
 	QuadRenderSystem::~QuadRenderSystem()
 	{
+		pipeline.join(); // The build may still be using the layout
 		vkDestroyPipelineLayout(narwhalDevice.device(), pipelineLayout, nullptr);
 	}
 	void QuadRenderSystem::createPipelineLayout(VkDescriptorSetLayout setLayout)
@@ -37,17 +38,19 @@ namespace narwhal {
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
-		PipelineConfigInfo pipelineConfig{};
-		NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
+		pipeline = narwhalDevice.getPipelineCompiler().compile([this, renderPass]() {
+			PipelineConfigInfo pipelineConfig{};
+			NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		pipeline = std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/quad.vert.spv", "data/shaders/quad.frag.spv", pipelineConfig);
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = pipelineLayout;
+			return std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/quad.vert.spv", "data/shaders/quad.frag.spv", pipelineConfig);
+		});
 	}
 
 	void QuadRenderSystem::render(QuadFrameInfo& frameInfo)
 	{
-		pipeline->bind(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+		pipeline.wait().bind(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
 
 		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.renderDescriptorSet, 0, nullptr);
 		quadModel->bind(frameInfo.commandBuffer);
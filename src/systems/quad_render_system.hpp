@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../narwhal_pipeline.hpp"
+#include "../narwhal_pipeline_compiler.hpp"
 #include "../narwhal_device.hpp"
 #include "../narwhal_camera.hpp"
 #include "../narwhal_game_object.hpp"
@@ -34,7 +35,7 @@ namespace narwhal {
 		void createPipelines(VkRenderPass renderPass);
 
 		NarwhalDevice& narwhalDevice;
-		std::unique_ptr<NarwhalPipeline> pipeline;
+		NarwhalPipelineHandle pipeline; // Built on the compiler threads, waited on at first use
 		std::shared_ptr<NarwhalModel> quadModel;
 		VkPipelineLayout pipelineLayout;
 	};
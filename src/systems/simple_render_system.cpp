@@ -17,7 +17,7 @@ namespace narwhal {
 		glm::mat4 modelMatrix{ 1.f }; //Identity matrix 
 		//alignas(16) glm::vec3 color; //See: https://registry.khronos.org/vulkan/specs/1.2/html/chap15.html#interfaces-resources-layout
 										// https://www.oreilly.com/library/view/opengl-programming-guide/9780132748445/app09lev1sec2.html
-		glm::mat4 normalMatrix{ 1.f };
+		glm::mat4 normalMatrix{ 1.f }; // Only the 3x3 is used, the last column carries the bindless material ids to stay in 128 bytes
 	};
 
 	SimpleRenderSystem::SimpleRenderSystem(NarwhalDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout ): narwhalDevice{device}
@@ -28,6 +28,7 @@ namespace narwhal {
 
 	SimpleRenderSystem::~SimpleRenderSystem()
 	{
+		narwhalPipeline.join(); // The build may still be using the layout
 		vkDestroyPipelineLayout(narwhalDevice.device(), pipelineLayout, nullptr);
 	}
 
@@ -39,7 +40,7 @@ namespace narwhal {
 		pushConstantRange.offset = 0;
 		pushConstantRange.size = sizeof(SimplePushConstantData);
 
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, narwhalDevice.getBindlessTable().getDescriptorSetLayout() };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -57,21 +58,25 @@ namespace narwhal {
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
-		PipelineConfigInfo pipelineConfig{};
-		NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
-
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		narwhalPipeline = std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/simple_shader.vert.spv", "data/shaders/simple_shader.frag.spv", pipelineConfig);
+		narwhalPipeline = narwhalDevice.getPipelineCompiler().compile([this, renderPass]() {
+			PipelineConfigInfo pipelineConfig{};
+			NarwhalPipeline::defaultPipelineConfigInfo(pipelineConfig);
 
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = pipelineLayout;
+			return std::make_unique<NarwhalPipeline>(narwhalDevice, "data/shaders/simple_shader.vert.spv", "data/shaders/simple_shader.frag.spv", pipelineConfig);
+		});
 	}
 
 
 	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo){
-		narwhalPipeline->bind(frameInfo.commandBuffer);
+		narwhalPipeline.wait().bind(frameInfo.commandBuffer);
 
 
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+		// Once per frame no matter how many models and materials there are
+		VkDescriptorSet bindlessSet = narwhalDevice.getBindlessTable().getDescriptorSet();
+		vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSet, 0, nullptr);
 		for (auto& kv : frameInfo.gameObjects) {
 			auto& obj = kv.second;
 			if (obj.model == nullptr) continue;
@@ -79,6 +84,7 @@ namespace narwhal {
 			SimplePushConstantData push{};
 			push.modelMatrix = obj.transform.mat4();
 			push.normalMatrix = obj.transform.normalMatrix();
+			push.normalMatrix[3] = glm::uintBitsToFloat(glm::uvec4(obj.model->getMaterialBufferIndex(), obj.model->getMaterialIndexBufferIndex(), 0, 0));
 
 			vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
 			obj.model->bind(frameInfo.commandBuffer);
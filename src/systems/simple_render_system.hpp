@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../narwhal_pipeline.hpp"
+#include "../narwhal_pipeline_compiler.hpp"
 #include "../narwhal_device.hpp"
 #include "../narwhal_camera.hpp"
 #include "../narwhal_game_object.hpp"
@@ -35,7 +36,7 @@ namespace narwhal {
 		NarwhalDevice &narwhalDevice;
 		
 
-		std::unique_ptr<NarwhalPipeline> narwhalPipeline;
+		NarwhalPipelineHandle narwhalPipeline; // Built on the compiler threads, waited on at first use
 		VkPipelineLayout pipelineLayout;
 	};
 